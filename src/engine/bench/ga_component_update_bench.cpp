@@ -0,0 +1,171 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Component update benchmark.
+** Runs ga_sim::update over entities that each have three components of
+** different types, entity by entity and then grouped by component type.
+** The components do a little math each, so the cost is mostly dispatch and
+** the code and data each type touches.
+**
+** Tried with components allocated entity by entity, as the demo does, and
+** type by type, as a per-type pool would place them.
+*/
+
+#include "entity/ga_component.h"
+#include "entity/ga_entity.h"
+#include "framework/ga_frame_params.h"
+#include "framework/ga_sim.h"
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+class spin_component : public ga_component
+{
+public:
+	spin_component(ga_entity* ent) : ga_component(ent), _angle(0.0f) {}
+
+	virtual void update(ga_frame_params* params) override
+	{
+		_angle += 0.01f;
+		if (_angle > 6.2831853f)
+		{
+			_angle -= 6.2831853f;
+		}
+	}
+
+	float _angle;
+};
+
+class move_component : public ga_component
+{
+public:
+	move_component(ga_entity* ent) : ga_component(ent)
+	{
+		_position = { 0.0f, 0.0f, 0.0f };
+		_velocity = { 0.1f, 0.0f, -0.1f };
+	}
+
+	virtual void update(ga_frame_params* params) override
+	{
+		_position += _velocity;
+		if (_position.x > 100.0f)
+		{
+			_velocity = -_velocity;
+		}
+	}
+
+	ga_vec3f _position;
+	ga_vec3f _velocity;
+};
+
+class pose_component : public ga_component
+{
+public:
+	pose_component(ga_entity* ent) : ga_component(ent)
+	{
+		ga_quatf rotation;
+		rotation.make_axis_angle(ga_vec3f::y_vector(), 0.01f);
+		_step.make_rotation(rotation);
+		_pose.make_identity();
+	}
+
+	virtual void update(ga_frame_params* params) override
+	{
+		_pose = _step * _pose;
+	}
+
+	ga_mat4f _step;
+	ga_mat4f _pose;
+};
+
+static double run(ga_sim* sim, ga_frame_params* params, bool by_type, int frame_count)
+{
+	sim->set_update_by_type(by_type);
+
+	double best_ms = 1e30;
+	for (int frame = 0; frame < frame_count; ++frame)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		sim->update(params);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+	}
+	return best_ms;
+}
+
+int main(int argc, const char** argv)
+{
+	int entity_count = argc > 1 ? atoi(argv[1]) : 100000;
+	int frame_count = argc > 2 ? atoi(argv[2]) : 20;
+
+	ga_job_config_t config;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	ga_job::startup(config);
+
+	printf("%d entities, 3 components each, %d workers, best of %d frames\n", entity_count, ga_job::get_worker_count(), frame_count);
+	printf("allocated         entity by entity ms  by type ms\n");
+
+	for (int layout = 0; layout < 2; ++layout)
+	{
+		ga_frame_params params;
+		ga_sim sim;
+
+		std::vector<ga_entity> entities(entity_count);
+		if (layout == 0)
+		{
+			for (auto& ent : entities)
+			{
+				new spin_component(&ent);
+				new move_component(&ent);
+				new pose_component(&ent);
+			}
+		}
+		else
+		{
+			for (auto& ent : entities)
+			{
+				new spin_component(&ent);
+			}
+			for (auto& ent : entities)
+			{
+				new move_component(&ent);
+			}
+			for (auto& ent : entities)
+			{
+				new pose_component(&ent);
+			}
+		}
+		for (auto& ent : entities)
+		{
+			sim.add_entity(&ent);
+		}
+
+		double per_entity_ms = run(&sim, &params, false, frame_count);
+		double by_type_ms = run(&sim, &params, true, frame_count);
+
+		printf("%-17s %20.3f %11.3f\n", layout == 0 ? "entity by entity" : "type by type", per_entity_ms, by_type_ms);
+
+		for (auto& ent : entities)
+		{
+			for (ga_component* c : ent.get_components())
+			{
+				delete c;
+			}
+		}
+	}
+
+	ga_job::shutdown();
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Draw sort benchmark.
+** Sorts a frame's worth of draw sort entries, as output does, with
+** ga_radix_sort and with std::sort. Keys come from ga_draw_sort_key over a
+** handful of materials, a few hundred vertex arrays and random depths.
+** Also counts how many material and vertex array changes drawing in
+** submission order would make, against sorted order.
+*/
+
+#include "framework/ga_drawcall.h"
+#include "framework/ga_radix_sort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+struct sort_entry_t
+{
+	uint64_t _key;
+	uint32_t _bucket;
+	uint32_t _packet;
+};
+
+static const int k_material_count = 8;
+static const int k_vao_count = 300;
+static const int k_trial_count = 20;
+
+static int count_state_changes(const std::vector<sort_entry_t>& entries)
+{
+	int changes = 0;
+	uint64_t state = ~0ull;
+	for (const sort_entry_t& e : entries)
+	{
+		uint64_t entry_state = e._key >> 24;
+		if (entry_state != state)
+		{
+			changes++;
+			state = entry_state;
+		}
+	}
+	return changes;
+}
+
+int main(int argc, const char** argv)
+{
+	int entry_count = argc > 1 ? atoi(argv[1]) : 100000;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> material(1, k_material_count);
+	std::uniform_int_distribution<int> vao(1, k_vao_count);
+	std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+
+	std::vector<sort_entry_t> submitted(entry_count);
+	for (int i = 0; i < entry_count; ++i)
+	{
+		submitted[i]._key = ga_draw_sort_key(material(rng), vao(rng), depth(rng));
+		submitted[i]._bucket = uint32_t(i & 7);
+		submitted[i]._packet = uint32_t(i);
+	}
+
+	std::vector<sort_entry_t> entries;
+	std::vector<sort_entry_t> scratch(entry_count);
+	std::vector<sort_entry_t> radix_sorted;
+	double radix_ms = 1e30;
+	double std_ms = 1e30;
+
+	for (int trial = 0; trial < k_trial_count; ++trial)
+	{
+		entries = submitted;
+		auto t0 = std::chrono::high_resolution_clock::now();
+		sort_entry_t* sorted = ga_radix_sort(entries.data(), scratch.data(), entries.size(),
+			[](const sort_entry_t& e) { return e._key; });
+		auto t1 = std::chrono::high_resolution_clock::now();
+		radix_ms = std::min(radix_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		radix_sorted.assign(sorted, sorted + entry_count);
+
+		entries = submitted;
+		t0 = std::chrono::high_resolution_clock::now();
+		std::stable_sort(entries.begin(), entries.end(),
+			[](const sort_entry_t& a, const sort_entry_t& b) { return a._key < b._key; });
+		t1 = std::chrono::high_resolution_clock::now();
+		std_ms = std::min(std_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+	}
+
+	for (int i = 0; i < entry_count; ++i)
+	{
+		if (radix_sorted[i]._key != entries[i]._key || radix_sorted[i]._packet != entries[i]._packet)
+		{
+			printf("error: radix sort differs from std::stable_sort at %d\n", i);
+			return 1;
+		}
+	}
+
+	printf("%d entries, best of %d\n", entry_count, k_trial_count);
+	printf("ga_radix_sort     %8.3f ms\n", radix_ms);
+	printf("std::stable_sort  %8.3f ms\n", std_ms);
+	printf("state changes: submitted order %d, sorted %d\n",
+		count_state_changes(submitted), count_state_changes(radix_sorted));
+	return 0;
+}
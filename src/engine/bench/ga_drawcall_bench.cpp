@@ -0,0 +1,205 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Drawcall emission benchmark.
+** Emits 100k draw packets per frame from a parallel_for, as the sim
+** does, with 1 to N worker threads. Compares one shared list behind a
+** ga_fiber_mutex, then concatenating the per-worker buckets into one list
+** afterwards, and the per-worker buckets used in place, as output does.
+** Lists are reused between frames, so after the first neither allocates
+** for the lists themselves.
+*/
+
+#include "framework/ga_frame_params.h"
+#include "jobs/ga_fiber_mutex.h"
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const int k_batch_size = 32;
+
+static int g_drawcall_count = 100000;
+static int g_frame_count = 20;
+
+static ga_draw_packet make_packet(int index)
+{
+	ga_draw_packet draw;
+	draw._name = 0;
+	draw._material = 1;
+	draw._vao = uint32_t(index);
+	draw._index_count = 36;
+	draw._draw_mode = GL_TRIANGLES;
+	return draw;
+}
+
+static ga_mat4f make_transform()
+{
+	ga_mat4f transform;
+	transform.make_identity();
+	return transform;
+}
+
+/* The first scheme: every drawcall goes through one lock. */
+static void emit_shared(std::vector<ga_draw_packet>* packets, std::vector<ga_mat4f>* transforms, ga_fiber_mutex* lock)
+{
+	ga_job::parallel_for(0, g_drawcall_count, k_batch_size, [packets, transforms, lock](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			ga_draw_packet draw = make_packet(i);
+			ga_mat4f transform = make_transform();
+
+			std::lock_guard<ga_fiber_mutex> guard(*lock);
+			draw._transform = uint32_t(transforms->size());
+			draw._skin = draw._transform + 1;
+			draw._skin_count = 0;
+			transforms->push_back(transform);
+			packets->push_back(draw);
+		}
+	},
+	k_job_priority_critical);
+}
+
+static void emit_buckets(ga_frame_params* params)
+{
+	ga_job::parallel_for(0, g_drawcall_count, k_batch_size, [params](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			params->add_draw_packet(make_packet(i), make_transform());
+		}
+	},
+	k_job_priority_critical);
+}
+
+/* What a gather step after the sim would add: one list built from the buckets. */
+static void concatenate_buckets(ga_frame_params* params, std::vector<ga_draw_packet>* packets, std::vector<ga_mat4f>* transforms)
+{
+	size_t packet_count = 0;
+	size_t transform_count = 0;
+	for (auto& bucket : params->_drawcall_buckets)
+	{
+		packet_count += bucket._draw_packets.size();
+		transform_count += bucket._transforms.size();
+	}
+	packets->reserve(packet_count);
+	transforms->reserve(transform_count);
+
+	for (auto& bucket : params->_drawcall_buckets)
+	{
+		uint32_t base = uint32_t(transforms->size());
+		transforms->insert(transforms->end(), bucket._transforms.begin(), bucket._transforms.end());
+		for (ga_draw_packet draw : bucket._draw_packets)
+		{
+			draw._transform += base;
+			draw._skin += base;
+			packets->push_back(draw);
+		}
+	}
+}
+
+struct trial_result_t
+{
+	double _shared_ms;
+	double _concatenated_ms;
+	double _buckets_ms;
+};
+
+static trial_result_t run_trial(int worker_count)
+{
+	uint32_t mask = worker_count >= 32 ? 0xffffffff : ((1u << worker_count) - 1);
+	ga_job::startup(mask, 1024, 256);
+
+	trial_result_t result = { 1e30, 1e30, 1e30 };
+
+	{
+		std::vector<ga_draw_packet> packets;
+		std::vector<ga_mat4f> transforms;
+		ga_fiber_mutex lock("ga_drawcall_bench");
+		for (int frame = 0; frame < g_frame_count; ++frame)
+		{
+			packets.clear();
+			transforms.clear();
+			auto t0 = std::chrono::high_resolution_clock::now();
+			emit_shared(&packets, &transforms, &lock);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			result._shared_ms = std::min(result._shared_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		}
+		if (int(packets.size()) != g_drawcall_count)
+		{
+			printf("error: shared list has %d drawcalls, expected %d\n", int(packets.size()), g_drawcall_count);
+			exit(1);
+		}
+	}
+
+	{
+		ga_frame_params params;
+		params._view.make_identity();
+		std::vector<ga_draw_packet> packets;
+		std::vector<ga_mat4f> transforms;
+		for (int frame = 0; frame < g_frame_count; ++frame)
+		{
+			params.reset();
+			packets.clear();
+			transforms.clear();
+			auto t0 = std::chrono::high_resolution_clock::now();
+			emit_buckets(&params);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			concatenate_buckets(&params, &packets, &transforms);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			result._buckets_ms = std::min(result._buckets_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+			result._concatenated_ms = std::min(result._concatenated_ms, std::chrono::duration<double, std::milli>(t2 - t0).count());
+		}
+		if (int(packets.size()) != g_drawcall_count)
+		{
+			printf("error: buckets held %d drawcalls, expected %d\n", int(packets.size()), g_drawcall_count);
+			exit(1);
+		}
+	}
+
+	ga_job::shutdown();
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	int max_workers = std::min(32, int(std::thread::hardware_concurrency()));
+	if (argc > 1)
+	{
+		max_workers = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		g_drawcall_count = atoi(argv[2]);
+	}
+
+	printf("%d draw packets per frame, best of %d frames\n", g_drawcall_count, g_frame_count);
+	printf("workers   shared ms  concatenated ms  buckets ms  speedup\n");
+	for (int workers = 1; workers <= max_workers; ++workers)
+	{
+		trial_result_t result = run_trial(workers);
+		printf("%7d %11.2f %16.2f %11.2f %8.2f\n",
+			workers,
+			result._shared_ms,
+			result._concatenated_ms,
+			result._buckets_ms,
+			result._shared_ms / result._buckets_ms);
+	}
+
+	ga_fiber_mutex::report_contention();
+	return 0;
+}
@@ -0,0 +1,292 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Entity churn benchmark.
+** Keeps a number of live entities with two components each in a ga_sim,
+** and every frame destroys some at random and creates as many again.
+** Reports the time to create them, to queue the destroys, and the frame's
+** update, which removes the destroyed ones first, next to an update with
+** no churn; and the heap allocations a churning frame makes once warm.
+** With creation and removal O(1), the churn cost shouldn't grow with the
+** number of live entities.
+**
+** Then the same churn recorded from inside update jobs: each entity has a
+** lifetime, and when it runs out despawns itself and spawns a replacement
+** through ga_entity_commands. Reports update, where the commands are
+** recorded, and late update, where they're played, next to a late update
+** with nothing to play.
+*/
+
+#include "entity/ga_component.h"
+#include "entity/ga_entity.h"
+#include "framework/ga_frame_params.h"
+#include "framework/ga_heap_counter.h"
+#include "framework/ga_sim.h"
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const int k_warmup_frames = 5;
+
+static int g_churn_count = 1000;
+static int g_frame_count = 20;
+
+class spin_component : public ga_component
+{
+public:
+	spin_component(ga_entity* ent) : ga_component(ent), _angle(0.0f) {}
+
+	virtual void update(ga_frame_params* params) override { _angle += 0.01f; }
+
+private:
+	float _angle;
+};
+
+class move_component : public ga_component
+{
+public:
+	move_component(ga_entity* ent) : ga_component(ent), _position({ 0.0f, 0.0f, 0.0f }), _velocity({ 0.1f, 0.0f, 0.0f }) {}
+
+	virtual void update(ga_frame_params* params) override { _position += _velocity; }
+
+private:
+	ga_vec3f _position;
+	ga_vec3f _velocity;
+};
+
+/* Replaces its entity with a new one every lifetime frames. */
+class lifetime_component : public ga_component
+{
+public:
+	lifetime_component(ga_entity* ent, ga_sim* sim, int lifetime, int frames_left) :
+		ga_component(ent), _sim(sim), _lifetime(lifetime), _frames_left(frames_left) {}
+
+	virtual void update(ga_frame_params* params) override
+	{
+		if (_lifetime == 0 || --_frames_left > 0)
+		{
+			return;
+		}
+
+		ga_entity_commands* commands = _sim->get_commands();
+		commands->despawn(get_entity()->get_handle());
+		ga_entity_handle replacement = commands->spawn();
+		commands->add_component<spin_component>(replacement);
+		commands->add_component<move_component>(replacement);
+		commands->add_component<lifetime_component>(replacement, _sim, _lifetime, _lifetime);
+	}
+
+private:
+	ga_sim* _sim;
+	int _lifetime;
+	int _frames_left;
+};
+
+static ga_entity_handle spawn(ga_sim* sim)
+{
+	ga_entity_handle handle = sim->create_entity();
+	new spin_component(sim->get_entity(handle));
+	new move_component(sim->get_entity(handle));
+	return handle;
+}
+
+static double get_ms(std::chrono::high_resolution_clock::time_point t0, std::chrono::high_resolution_clock::time_point t1)
+{
+	return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+struct trial_result_t
+{
+	double _create_ms;
+	double _destroy_ms;
+	double _update_ms;
+	double _idle_update_ms;
+	uint64_t _max_allocations;
+};
+
+static trial_result_t run_trial(int live_count)
+{
+	trial_result_t result = { 1e30, 1e30, 1e30, 1e30, 0 };
+
+	ga_sim sim;
+	ga_frame_params params;
+	std::vector<ga_entity_handle> live;
+	for (int i = 0; i < live_count; ++i)
+	{
+		live.push_back(spawn(&sim));
+	}
+
+	std::mt19937 random(1234);
+	std::vector<ga_entity_handle> destroyed;
+	for (int frame = 0; frame < k_warmup_frames + g_frame_count; ++frame)
+	{
+		uint64_t allocations_begin = ga_heap_counter::get_allocation_count();
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		destroyed.clear();
+		for (int i = 0; i < g_churn_count; ++i)
+		{
+			size_t victim = random() % live.size();
+			sim.destroy_entity(live[victim]);
+			destroyed.push_back(live[victim]);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < g_churn_count; ++i)
+		{
+			live.push_back(spawn(&sim));
+		}
+		auto t2 = std::chrono::high_resolution_clock::now();
+		sim.update(&params);
+		auto t3 = std::chrono::high_resolution_clock::now();
+		sim.update(&params);
+		auto t4 = std::chrono::high_resolution_clock::now();
+
+		// Stale handles must find nothing, slots reused or not.
+		for (ga_entity_handle handle : destroyed)
+		{
+			if (sim.is_alive(handle))
+			{
+				printf("error: destroyed entity %u is still alive\n", handle._index);
+				exit(1);
+			}
+		}
+		if (sim.get_entity_count() != uint32_t(live_count))
+		{
+			printf("error: %u entities, expected %d\n", sim.get_entity_count(), live_count);
+			exit(1);
+		}
+
+		if (frame >= k_warmup_frames)
+		{
+			result._destroy_ms = std::min(result._destroy_ms, get_ms(t0, t1));
+			result._create_ms = std::min(result._create_ms, get_ms(t1, t2));
+			result._update_ms = std::min(result._update_ms, get_ms(t2, t3));
+			result._idle_update_ms = std::min(result._idle_update_ms, get_ms(t3, t4));
+			uint64_t allocations = ga_heap_counter::get_allocation_count() - allocations_begin;
+			result._max_allocations = std::max(result._max_allocations, allocations);
+		}
+	}
+	return result;
+}
+
+struct command_result_t
+{
+	double _update_ms;
+	double _late_update_ms;
+	double _idle_late_update_ms;
+	uint64_t _max_allocations;
+};
+
+static command_result_t run_command_trial(int live_count)
+{
+	command_result_t result = { 1e30, 1e30, 1e30, 0 };
+
+	// Lifetimes run out for churn_count entities a frame.
+	int lifetime = std::max(1, live_count / g_churn_count);
+	ga_sim sim;
+	ga_sim idle_sim;
+	for (int i = 0; i < live_count; ++i)
+	{
+		ga_entity_handle handle = sim.create_entity();
+		new spin_component(sim.get_entity(handle));
+		new move_component(sim.get_entity(handle));
+		new lifetime_component(sim.get_entity(handle), &sim, lifetime, i % lifetime + 1);
+
+		ga_entity_handle idle_handle = idle_sim.create_entity();
+		new spin_component(idle_sim.get_entity(idle_handle));
+		new move_component(idle_sim.get_entity(idle_handle));
+		new lifetime_component(idle_sim.get_entity(idle_handle), &idle_sim, 0, 0);
+	}
+
+	ga_frame_params params;
+	for (int frame = 0; frame < k_warmup_frames + g_frame_count; ++frame)
+	{
+		uint64_t allocations_begin = ga_heap_counter::get_allocation_count();
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		sim.update(&params);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		sim.late_update(&params);
+		auto t2 = std::chrono::high_resolution_clock::now();
+
+		uint64_t allocations = ga_heap_counter::get_allocation_count() - allocations_begin;
+
+		idle_sim.update(&params);
+		auto t3 = std::chrono::high_resolution_clock::now();
+		idle_sim.late_update(&params);
+		auto t4 = std::chrono::high_resolution_clock::now();
+
+		if (sim.get_entity_count() != uint32_t(live_count))
+		{
+			printf("error: %u entities, expected %d\n", sim.get_entity_count(), live_count);
+			exit(1);
+		}
+
+		if (frame >= k_warmup_frames)
+		{
+			result._update_ms = std::min(result._update_ms, get_ms(t0, t1));
+			result._late_update_ms = std::min(result._late_update_ms, get_ms(t1, t2));
+			result._idle_late_update_ms = std::min(result._idle_late_update_ms, get_ms(t3, t4));
+			result._max_allocations = std::max(result._max_allocations, allocations);
+		}
+	}
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc > 1)
+	{
+		g_churn_count = atoi(argv[1]);
+	}
+
+	ga_job_config_t config;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	ga_job::startup(config);
+
+	printf("%d entities destroyed and created per frame, %d workers, best of %d frames\n", g_churn_count, ga_job::get_worker_count(), g_frame_count);
+	printf("     live  create ms  destroy ms  update ms  idle update ms  allocations\n");
+	for (int live_count : { 10000, 100000, 1000000 })
+	{
+		trial_result_t result = run_trial(std::max(live_count, g_churn_count));
+		printf("%9d %10.3f %11.3f %10.3f %15.3f %12llu\n",
+			live_count,
+			result._create_ms,
+			result._destroy_ms,
+			result._update_ms,
+			result._idle_update_ms,
+			(unsigned long long)result._max_allocations);
+	}
+
+	printf("\nRecorded from update jobs\n");
+	printf("     live  update ms  late update ms  idle late update ms  allocations\n");
+	for (int live_count : { 10000, 100000, 1000000 })
+	{
+		command_result_t result = run_command_trial(std::max(live_count, g_churn_count));
+		printf("%9d %10.3f %15.3f %20.3f %12llu\n",
+			live_count,
+			result._update_ms,
+			result._late_update_ms,
+			result._idle_late_update_ms,
+			(unsigned long long)result._max_allocations);
+	}
+
+	ga_job::shutdown();
+	return 0;
+}
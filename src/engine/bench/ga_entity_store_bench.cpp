@@ -0,0 +1,218 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Entity store benchmark.
+** Updates entities with the same three pieces of state three ways:
+** - ga_entity with three virtual ga_components each, allocated one by one;
+** - the same ga_entities, run through ga_entity_adapter in the store;
+** - store components, updated by a system per type.
+** Reports the best frame time and entity updates per second.
+*/
+
+#include "entity/ga_component.h"
+#include "entity/ga_entity.h"
+#include "entity/ga_entity_store.h"
+#include "framework/ga_frame_params.h"
+#include "framework/ga_sim.h"
+#include "jobs/ga_job.h"
+#include "math/ga_mat4f.h"
+#include "math/ga_quatf.h"
+#include "math/ga_vec3f.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+static const int k_batch_size = 256;
+
+/* State shared by both forms of each component. */
+struct spin_state_t
+{
+	float _angle;
+
+	void update()
+	{
+		_angle += 0.01f;
+		if (_angle > 6.2831853f)
+		{
+			_angle -= 6.2831853f;
+		}
+	}
+};
+
+struct move_state_t
+{
+	ga_vec3f _position;
+	ga_vec3f _velocity;
+
+	void update()
+	{
+		_position += _velocity;
+		if (_position.x > 100.0f)
+		{
+			_velocity = -_velocity;
+		}
+	}
+};
+
+struct pose_state_t
+{
+	ga_mat4f _step;
+	ga_mat4f _pose;
+
+	void update()
+	{
+		_pose = _step * _pose;
+	}
+};
+
+static spin_state_t make_spin()
+{
+	return { 0.0f };
+}
+
+static move_state_t make_move()
+{
+	return { { 0.0f, 0.0f, 0.0f }, { 0.1f, 0.0f, -0.1f } };
+}
+
+static pose_state_t make_pose()
+{
+	pose_state_t pose;
+	ga_quatf rotation;
+	rotation.make_axis_angle(ga_vec3f::y_vector(), 0.01f);
+	pose._step.make_rotation(rotation);
+	pose._pose.make_identity();
+	return pose;
+}
+
+template<class T>
+class state_component : public ga_component
+{
+public:
+	state_component(ga_entity* ent, const T& state) : ga_component(ent), _state(state) {}
+
+	virtual void update(ga_frame_params* params) override { _state.update(); }
+
+	T _state;
+};
+
+static void update_spin(ga_entity_store* store, ga_frame_params* params)
+{
+	store->parallel_for_each<spin_state_t>(k_batch_size, [](ga_entity_id id, spin_state_t& spin) { spin.update(); }, k_job_priority_critical);
+}
+
+static void update_move(ga_entity_store* store, ga_frame_params* params)
+{
+	store->parallel_for_each<move_state_t>(k_batch_size, [](ga_entity_id id, move_state_t& move) { move.update(); }, k_job_priority_critical);
+}
+
+static void update_pose(ga_entity_store* store, ga_frame_params* params)
+{
+	store->parallel_for_each<pose_state_t>(k_batch_size, [](ga_entity_id id, pose_state_t& pose) { pose.update(); }, k_job_priority_critical);
+}
+
+static double run(ga_sim* sim, int frame_count)
+{
+	ga_frame_params params;
+
+	double best_ms = 1e30;
+	for (int frame = 0; frame < frame_count; ++frame)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		sim->update(&params);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+	}
+	return best_ms;
+}
+
+static void report(const char* name, int entity_count, double ms)
+{
+	printf("%-22s %9.3f ms %10.1f M entities/s\n", name, ms, entity_count / ms / 1000.0);
+}
+
+static void add_legacy_components(ga_entity* ent)
+{
+	new state_component<spin_state_t>(ent, make_spin());
+	new state_component<move_state_t>(ent, make_move());
+	new state_component<pose_state_t>(ent, make_pose());
+}
+
+static void delete_legacy_components(std::vector<ga_entity>& entities)
+{
+	for (auto& ent : entities)
+	{
+		for (ga_component* c : ent.get_components())
+		{
+			delete c;
+		}
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	int entity_count = argc > 1 ? atoi(argv[1]) : 100000;
+	int frame_count = argc > 2 ? atoi(argv[2]) : 20;
+
+	ga_job_config_t config;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	ga_job::startup(config);
+
+	printf("%d entities, 3 components each, %d workers, best of %d frames\n", entity_count, ga_job::get_worker_count(), frame_count);
+
+	{
+		ga_sim sim;
+		std::vector<ga_entity> entities(entity_count);
+		for (auto& ent : entities)
+		{
+			add_legacy_components(&ent);
+			sim.add_entity(&ent);
+		}
+		report("ga_entity", entity_count, run(&sim, frame_count));
+		delete_legacy_components(entities);
+	}
+
+	{
+		ga_sim sim;
+		std::vector<ga_entity> entities(entity_count);
+		for (auto& ent : entities)
+		{
+			add_legacy_components(&ent);
+			ga_entity_id id = sim.get_entity_store()->create();
+			sim.get_entity_store()->add<ga_entity_adapter>(id, { &ent });
+		}
+		report("ga_entity_adapter", entity_count, run(&sim, frame_count));
+		delete_legacy_components(entities);
+	}
+
+	{
+		ga_sim sim;
+		ga_entity_store* store = sim.get_entity_store();
+		for (int i = 0; i < entity_count; ++i)
+		{
+			ga_entity_id id = store->create();
+			store->add<spin_state_t>(id, make_spin());
+			store->add<move_state_t>(id, make_move());
+			store->add<pose_state_t>(id, make_pose());
+		}
+		sim.add_update_system(update_spin);
+		sim.add_update_system(update_move);
+		sim.add_update_system(update_pose);
+		report("ga_entity_store", entity_count, run(&sim, frame_count));
+	}
+
+	ga_job::shutdown();
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Idle worker wakeup benchmark.
+** Compares ga_condvar, as the scheduler used it (wake_all on every submit,
+** workers polling with wait_for), against ga_event_count.
+**
+** notify: cost of a wake call when no thread is parked, which is what most
+** submits pay.
+** handoff: N parked threads; the main thread posts one token at a time and
+** waits for a thread to take it. Reports the round trip and how many threads
+** woke per token; anything above one is the thundering herd.
+*/
+
+#include "jobs/ga_condvar.h"
+#include "jobs/ga_event_count.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+struct handoff_state_t
+{
+	std::atomic_int _tokens;
+	std::atomic_int _taken;
+	std::atomic_bool _stop;
+	std::atomic<uint64_t> _wakeups;
+};
+
+static bool take_token(handoff_state_t* state)
+{
+	int tokens = state->_tokens.load();
+	while (tokens > 0)
+	{
+		if (state->_tokens.compare_exchange_weak(tokens, tokens - 1))
+		{
+			state->_taken++;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void condvar_sleeper(handoff_state_t* state, ga_condvar* condvar)
+{
+	while (!state->_stop)
+	{
+		if (!take_token(state))
+		{
+			condvar->wait_for(1000);
+			state->_wakeups++;
+		}
+	}
+}
+
+static void event_count_sleeper(handoff_state_t* state, ga_event_count* event_count)
+{
+	while (!state->_stop)
+	{
+		if (take_token(state))
+		{
+			continue;
+		}
+
+		uint32_t key = event_count->prepare_wait();
+		if (state->_stop || state->_tokens.load() > 0)
+		{
+			event_count->cancel_wait();
+			continue;
+		}
+		event_count->wait(key, 1000);
+		state->_wakeups++;
+	}
+}
+
+struct handoff_result_t
+{
+	double _round_trip_ns;
+	double _wakeups_per_token;
+};
+
+template<class T, class S, class N>
+static handoff_result_t run_handoff(int sleeper_count, int token_count, S sleeper, N notify)
+{
+	T primitive;
+	handoff_state_t state;
+	state._tokens = 0;
+	state._taken = 0;
+	state._stop = false;
+	state._wakeups = 0;
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < sleeper_count; ++i)
+	{
+		threads.emplace_back(sleeper, &state, &primitive);
+	}
+
+	/* Let every sleeper park before timing. */
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	state._wakeups = 0;
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < token_count; ++i)
+	{
+		state._tokens++;
+		notify(&primitive);
+		while (state._taken.load() <= i)
+		{
+			std::this_thread::yield();
+		}
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+	uint64_t wakeups = state._wakeups;
+
+	state._stop = true;
+	for (auto& t : threads)
+	{
+		while (t.joinable())
+		{
+			notify(&primitive);
+			t.join();
+		}
+	}
+
+	handoff_result_t result;
+	result._round_trip_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / token_count;
+	result._wakeups_per_token = double(wakeups) / token_count;
+	return result;
+}
+
+template<class T, class N>
+static double run_notify(int call_count, N notify)
+{
+	T primitive;
+	auto t0 = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < call_count; ++i)
+	{
+		notify(&primitive);
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / call_count;
+}
+
+int main(int argc, const char** argv)
+{
+	int max_sleepers = argc > 1 ? atoi(argv[1]) : 8;
+	int token_count = argc > 2 ? atoi(argv[2]) : 2000;
+
+	auto condvar_notify = [](ga_condvar* condvar) { condvar->wake_all(); };
+	auto event_count_notify = [](ga_event_count* event_count) { event_count->notify(1); };
+
+	printf("notify, nobody parked:  ga_condvar %6.1f ns  ga_event_count %6.1f ns\n",
+		run_notify<ga_condvar>(10000000, condvar_notify),
+		run_notify<ga_event_count>(10000000, event_count_notify));
+
+	printf("parked     ga_condvar ns  wakeups  ga_event_count ns  wakeups\n");
+	for (int sleepers = 1; sleepers <= max_sleepers; sleepers *= 2)
+	{
+		handoff_result_t condvar = run_handoff<ga_condvar>(sleepers, token_count, condvar_sleeper, condvar_notify);
+		handoff_result_t event_count = run_handoff<ga_event_count>(sleepers, token_count, event_count_sleeper, event_count_notify);
+		printf("%6d %16.0f %8.2f %18.0f %8.2f\n",
+			sleepers,
+			condvar._round_trip_ns, condvar._wakeups_per_token,
+			event_count._round_trip_ns, event_count._wakeups_per_token);
+	}
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Fiber context switch microbenchmark.
+** Ping-pongs between a thread fiber and a worker fiber and reports the cost
+** of a single switch. On Linux, swapcontext is measured for comparison.
+*/
+
+#include "framework/ga_compiler_defines.h"
+#include "jobs/ga_fiber.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(GA_LINUX)
+#include <ucontext.h>
+#endif
+
+static const int k_default_iterations = 10000000;
+
+static ga_fiber* g_thread_fiber;
+static ga_fiber* g_ping_fiber;
+
+static void ping_fiber_worker(void* data)
+{
+	uint64_t* count = static_cast<uint64_t*>(data);
+	for (;;)
+	{
+		++*count;
+		ga_fiber::switch_to(*g_thread_fiber);
+	}
+}
+
+static void report(const char* name, int switches, std::chrono::high_resolution_clock::duration elapsed)
+{
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	printf("%-12s %10d switches  %14.0f switches/s  %8.2f ns/switch\n",
+		name,
+		switches,
+		switches / seconds,
+		seconds * 1e9 / switches);
+}
+
+#if defined(GA_LINUX)
+static ucontext_t g_thread_context;
+static ucontext_t g_ping_context;
+static uint64_t g_ucontext_count;
+
+static void ping_ucontext_worker()
+{
+	for (;;)
+	{
+		++g_ucontext_count;
+		swapcontext(&g_ping_context, &g_thread_context);
+	}
+}
+#endif
+
+int main(int argc, const char** argv)
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : k_default_iterations;
+
+	uint64_t count = 0;
+	ga_fiber thread_fiber = ga_fiber::convert_thread(0);
+	ga_fiber ping_fiber(ping_fiber_worker, &count, 64 * 1024);
+	g_thread_fiber = &thread_fiber;
+	g_ping_fiber = &ping_fiber;
+
+	// Warm up: the first switch faults in the fiber's stack.
+	ga_fiber::switch_to(ping_fiber);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		ga_fiber::switch_to(ping_fiber);
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	if (count != uint64_t(iterations) + 1)
+	{
+		printf("ga_fiber: expected %d round trips, got %llu.\n", iterations + 1, (unsigned long long)count);
+		return 1;
+	}
+	report("ga_fiber", iterations * 2, t1 - t0);
+
+#if defined(GA_LINUX)
+	const size_t k_stack_size = 64 * 1024;
+	char* stack = new char[k_stack_size];
+	getcontext(&g_ping_context);
+	g_ping_context.uc_stack.ss_sp = stack;
+	g_ping_context.uc_stack.ss_size = k_stack_size;
+	g_ping_context.uc_link = 0;
+	makecontext(&g_ping_context, ping_ucontext_worker, 0);
+
+	swapcontext(&g_thread_context, &g_ping_context);
+
+	t0 = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		swapcontext(&g_thread_context, &g_ping_context);
+	}
+	t1 = std::chrono::high_resolution_clock::now();
+	report("swapcontext", iterations * 2, t1 - t0);
+
+	delete[] stack;
+#endif
+
+	return 0;
+}
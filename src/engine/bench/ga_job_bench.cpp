@@ -0,0 +1,126 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Job system scaling benchmark.
+** Runs a many-tiny-jobs workload with 1 to N worker threads. Root jobs fan
+** out batches of leaf jobs from inside the workers, which exercises both the
+** per-worker deques and stealing.
+*/
+
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static const int k_root_count = 32;
+static const int k_leaf_batch = 64;
+static const int k_leaf_spin = 64;
+
+static int g_batches_per_root = 100;
+static std::atomic<uint64_t> g_leaf_count;
+
+static void leaf_job(void* data)
+{
+	volatile uint32_t x = uint32_t(reinterpret_cast<uintptr_t>(data));
+	for (int i = 0; i < k_leaf_spin; ++i)
+	{
+		x = x * 1664525u + 1013904223u;
+	}
+	g_leaf_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void root_job(void* data)
+{
+	ga_job_decl_t decls[k_leaf_batch];
+	for (int i = 0; i < k_leaf_batch; ++i)
+	{
+		decls[i]._entry = leaf_job;
+		decls[i]._data = reinterpret_cast<void*>(uintptr_t(i));
+	}
+
+	for (int b = 0; b < g_batches_per_root; ++b)
+	{
+		ga_job_counter_t counter;
+		ga_job::run(decls, k_leaf_batch, &counter);
+		ga_job::wait(&counter);
+	}
+}
+
+static double run_trial(int worker_count)
+{
+	uint32_t mask = worker_count >= 32 ? 0xffffffff : ((1u << worker_count) - 1);
+	ga_job::startup(mask, 1024, 256);
+
+	g_leaf_count = 0;
+
+	ga_job_decl_t decls[k_root_count];
+	for (int i = 0; i < k_root_count; ++i)
+	{
+		decls[i]._entry = root_job;
+		decls[i]._data = 0;
+	}
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	ga_job_counter_t counter;
+	ga_job::run(decls, k_root_count, &counter);
+	ga_job::wait(&counter);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	ga_job::shutdown();
+
+	uint64_t expected = uint64_t(k_root_count) * k_leaf_batch * g_batches_per_root;
+	if (g_leaf_count != expected)
+	{
+		printf("error: ran %llu leaf jobs, expected %llu\n", (unsigned long long)g_leaf_count.load(), (unsigned long long)expected);
+		exit(1);
+	}
+
+	return std::chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, const char** argv)
+{
+	int max_workers = std::min(32, int(std::thread::hardware_concurrency()));
+	if (argc > 1)
+	{
+		max_workers = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		g_batches_per_root = atoi(argv[2]);
+	}
+
+	uint64_t job_count = uint64_t(k_root_count) * (k_leaf_batch * g_batches_per_root + 1);
+	printf("%llu jobs per trial\n", (unsigned long long)job_count);
+	printf("workers      seconds        jobs/s   ns/job  speedup\n");
+
+	double baseline = 0.0;
+	for (int workers = 1; workers <= max_workers; ++workers)
+	{
+		double seconds = run_trial(workers);
+		if (workers == 1)
+		{
+			baseline = seconds;
+		}
+		printf("%7d %12.4f %13.0f %8.1f %8.2f\n",
+			workers,
+			seconds,
+			job_count / seconds,
+			seconds * 1e9 / job_count,
+			baseline / seconds);
+	}
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Worker pinning benchmark.
+** Runs the same simulated frames with pinned and unpinned workers and
+** reports the spread of frame times. Each frame updates a working set that
+** fits in cache when workers stay on their cores.
+*/
+
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct bench_entity_t
+{
+	float _position[4];
+	float _velocity[4];
+	float _padding[8];
+};
+
+static const int k_entity_count = 64 * 1024;
+static const int k_grain = 256;
+
+static std::vector<bench_entity_t> g_entities;
+
+static void update_entities(int begin, int end, void* data)
+{
+	float dt = *static_cast<float*>(data);
+	for (int i = begin; i < end; ++i)
+	{
+		bench_entity_t& e = g_entities[i];
+		for (int c = 0; c < 4; ++c)
+		{
+			e._velocity[c] = e._velocity[c] * 0.999f - e._position[c] * 0.001f;
+			e._position[c] += e._velocity[c] * dt;
+		}
+	}
+}
+
+static void run_frames(const char* name, bool pin, bool smt, int frame_count)
+{
+	ga_job_config_t config;
+	config._pin_threads = pin;
+	config._use_smt_siblings = smt;
+	config._report_layout = pin;
+	ga_job::startup(config);
+
+	std::vector<double> frame_ms;
+	float dt = 1.0f / 60.0f;
+	for (int f = 0; f < frame_count + 10; ++f)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			ga_job::parallel_for(0, k_entity_count, k_grain, update_entities, &dt, k_job_priority_critical);
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		/* Skip warm-up frames. */
+		if (f >= 10)
+		{
+			frame_ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+		}
+	}
+
+	ga_job::shutdown();
+
+	double mean = 0.0;
+	for (double ms : frame_ms)
+	{
+		mean += ms;
+	}
+	mean /= frame_ms.size();
+
+	double variance = 0.0;
+	for (double ms : frame_ms)
+	{
+		variance += (ms - mean) * (ms - mean);
+	}
+	variance /= frame_ms.size();
+
+	std::sort(frame_ms.begin(), frame_ms.end());
+	double p99 = frame_ms[size_t(frame_ms.size() * 0.99)];
+
+	printf("%-10s mean %7.3f ms  stddev %7.3f ms  min %7.3f  p99 %7.3f  max %7.3f\n",
+		name, mean, std::sqrt(variance), frame_ms.front(), p99, frame_ms.back());
+}
+
+int main(int argc, const char** argv)
+{
+	int frame_count = argc > 1 ? atoi(argv[1]) : 500;
+	bool smt = argc > 2 && atoi(argv[2]) != 0;
+
+	g_entities.resize(k_entity_count);
+	for (int i = 0; i < k_entity_count; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			g_entities[i]._position[c] = float(i % 97);
+			g_entities[i]._velocity[c] = 0.0f;
+		}
+	}
+
+	run_frames("pinned", true, smt, frame_count);
+	run_frames("unpinned", false, smt, frame_count);
+
+	return 0;
+}
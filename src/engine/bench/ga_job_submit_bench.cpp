@@ -0,0 +1,140 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Job submission benchmark.
+** Compares the cost of submitting and running trivial jobs through a batch
+** of decls, one decl per run call, and one lambda per run call. Submission
+** is timed on its own, then the time to drain the jobs.
+*/
+
+#include "jobs/ga_job.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static std::atomic<uint64_t> g_sum;
+
+static void add_job(void* data)
+{
+	g_sum.fetch_add(reinterpret_cast<uintptr_t>(data), std::memory_order_relaxed);
+}
+
+struct bench_result_t
+{
+	double _submit_ns;
+	double _total_ns;
+};
+
+template<class T>
+static bench_result_t measure(int job_count, T submit)
+{
+	g_sum = 0;
+
+	ga_job_counter_t counter;
+	auto t0 = std::chrono::high_resolution_clock::now();
+	submit(&counter);
+	auto t1 = std::chrono::high_resolution_clock::now();
+	ga_job::wait(&counter);
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	uint64_t expected = uint64_t(job_count) * (job_count + 1) / 2;
+	if (g_sum != expected)
+	{
+		printf("error: jobs summed to %llu, expected %llu\n", (unsigned long long)g_sum.load(), (unsigned long long)expected);
+		exit(1);
+	}
+
+	bench_result_t result;
+	result._submit_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / job_count;
+	result._total_ns = std::chrono::duration<double, std::nano>(t2 - t0).count() / job_count;
+	return result;
+}
+
+static void report(const char* name, bench_result_t result)
+{
+	printf("%-14s %10.1f %10.1f\n", name, result._submit_ns, result._total_ns);
+}
+
+int main(int argc, const char** argv)
+{
+	int job_count = argc > 1 ? atoi(argv[1]) : 4096;
+	int trials = argc > 2 ? atoi(argv[2]) : 20;
+
+	ga_job_config_t config;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	config._queue_size = job_count;
+	config._fiber_count[k_job_stack_default] = 256;
+	config._record_count = job_count;
+	ga_job::startup(config);
+
+	std::vector<ga_job_decl_t> decls(job_count);
+
+	bench_result_t batch = { 1e30, 1e30 };
+	bench_result_t single = { 1e30, 1e30 };
+	bench_result_t lambda = { 1e30, 1e30 };
+
+	/* Keep the best of several trials; the first of each warms the pools. */
+	for (int t = 0; t < trials; ++t)
+	{
+		bench_result_t r = measure(job_count, [&](ga_job_counter_t* counter)
+		{
+			for (int i = 0; i < job_count; ++i)
+			{
+				decls[i]._entry = add_job;
+				decls[i]._data = reinterpret_cast<void*>(uintptr_t(i + 1));
+			}
+			ga_job::run(decls.data(), job_count, counter);
+		});
+		batch._submit_ns = std::min(batch._submit_ns, r._submit_ns);
+		batch._total_ns = std::min(batch._total_ns, r._total_ns);
+
+		r = measure(job_count, [&](ga_job_counter_t* counter)
+		{
+			for (int i = 0; i < job_count; ++i)
+			{
+				decls[i]._entry = add_job;
+				decls[i]._data = reinterpret_cast<void*>(uintptr_t(i + 1));
+				ga_job::run(&decls[i], 1, counter);
+			}
+		});
+		single._submit_ns = std::min(single._submit_ns, r._submit_ns);
+		single._total_ns = std::min(single._total_ns, r._total_ns);
+
+		r = measure(job_count, [&](ga_job_counter_t* counter)
+		{
+			for (int i = 0; i < job_count; ++i)
+			{
+				uint64_t value = uint64_t(i + 1);
+				ga_job::run([value]()
+				{
+					g_sum.fetch_add(value, std::memory_order_relaxed);
+				},
+				counter);
+			}
+		});
+		lambda._submit_ns = std::min(lambda._submit_ns, r._submit_ns);
+		lambda._total_ns = std::min(lambda._total_ns, r._total_ns);
+	}
+
+	ga_job::shutdown();
+
+	printf("%d jobs, best of %d trials\n", job_count, trials);
+	printf("path           submit ns/job  total ns/job\n");
+	report("decl batch", batch);
+	report("decl single", single);
+	report("lambda", lambda);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Nested wait benchmark.
+** Measures scheduling overhead when many fibers are suspended in
+** ga_job::wait at once: a binary tree where every inner job waits on its
+** two children, and a deep chain where every job waits on a single child.
+*/
+
+#include "jobs/ga_job.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+static std::atomic<uint64_t> g_job_count;
+
+static void tree_job(void* data)
+{
+	g_job_count.fetch_add(1, std::memory_order_relaxed);
+
+	intptr_t depth = reinterpret_cast<intptr_t>(data);
+	if (depth == 0)
+	{
+		return;
+	}
+
+	ga_job_decl_t decls[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		decls[i]._entry = tree_job;
+		decls[i]._data = reinterpret_cast<void*>(depth - 1);
+	}
+
+	ga_job_counter_t counter;
+	ga_job::run(decls, 2, &counter);
+	ga_job::wait(&counter);
+}
+
+static void chain_job(void* data)
+{
+	g_job_count.fetch_add(1, std::memory_order_relaxed);
+
+	intptr_t depth = reinterpret_cast<intptr_t>(data);
+	if (depth == 0)
+	{
+		return;
+	}
+
+	ga_job_decl_t decl;
+	decl._entry = chain_job;
+	decl._data = reinterpret_cast<void*>(depth - 1);
+
+	ga_job_counter_t counter;
+	ga_job::run(&decl, 1, &counter);
+	ga_job::wait(&counter);
+}
+
+static void run_case(const char* name, ga_job_function_t entry, intptr_t depth, int repeat)
+{
+	g_job_count = 0;
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeat; ++r)
+	{
+		ga_job_decl_t decl;
+		decl._entry = entry;
+		decl._data = reinterpret_cast<void*>(depth);
+
+		ga_job_counter_t counter;
+		ga_job::run(&decl, 1, &counter);
+		ga_job::wait(&counter);
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	double seconds = std::chrono::duration<double>(t1 - t0).count();
+	uint64_t jobs = g_job_count.load();
+	printf("%-8s depth %4d  %9llu jobs  %10.4f s  %8.1f ns/job\n",
+		name,
+		int(depth),
+		(unsigned long long)jobs,
+		seconds,
+		seconds * 1e9 / jobs);
+}
+
+int main(int argc, const char** argv)
+{
+	uint32_t mask = argc > 1 ? uint32_t(strtoul(argv[1], 0, 0)) : 0xffff;
+	int repeat = argc > 2 ? atoi(argv[2]) : 20;
+
+	ga_job::startup(mask, 4096, 2048);
+
+	run_case("tree", tree_job, 12, repeat);
+	run_case("chain", chain_job, 1000, repeat);
+
+	ga_job::shutdown();
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Queue contention benchmark.
+** Pushes and pops through ga_queue and ga_ring_queue with 1 to N producer
+** and consumer threads. Every pushed value is popped exactly once; the sum
+** of popped values is checked against the sum of pushed values.
+** ga_queue can't push once its nodes run out, so both queues are sized to
+** hold every item in a trial.
+*/
+
+#include "jobs/ga_queue.h"
+#include "jobs/ga_ring_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static int g_items_per_producer = 200000;
+
+template<class T>
+static double run_trial(int producer_count, int consumer_count)
+{
+	uint64_t expected_count = uint64_t(producer_count) * g_items_per_producer;
+
+	T queue(int(expected_count) + 1);
+
+	std::atomic_int ready(0);
+	std::atomic_bool go(false);
+	std::atomic<uint64_t> popped_count(0);
+	std::atomic<uint64_t> popped_sum(0);
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producer_count; ++p)
+	{
+		threads.emplace_back([&, p]()
+		{
+			ready++;
+			while (!go.load(std::memory_order_acquire)) {}
+
+			/* Values start at 1 so a null pointer is never queued. */
+			uintptr_t base = uintptr_t(p) * g_items_per_producer + 1;
+			for (int i = 0; i < g_items_per_producer; ++i)
+			{
+				queue.push(reinterpret_cast<void*>(base + i));
+			}
+		});
+	}
+
+	for (int c = 0; c < consumer_count; ++c)
+	{
+		threads.emplace_back([&]()
+		{
+			ready++;
+			while (!go.load(std::memory_order_acquire)) {}
+
+			uint64_t count = 0;
+			uint64_t sum = 0;
+			while (popped_count.load(std::memory_order_relaxed) < expected_count)
+			{
+				void* data;
+				if (queue.pop(&data))
+				{
+					sum += reinterpret_cast<uintptr_t>(data);
+					++count;
+					if ((count & 255) == 0)
+					{
+						popped_count.fetch_add(count, std::memory_order_relaxed);
+						popped_sum.fetch_add(sum, std::memory_order_relaxed);
+						count = 0;
+						sum = 0;
+					}
+				}
+				else if (count)
+				{
+					popped_count.fetch_add(count, std::memory_order_relaxed);
+					popped_sum.fetch_add(sum, std::memory_order_relaxed);
+					count = 0;
+					sum = 0;
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+			popped_count.fetch_add(count, std::memory_order_relaxed);
+			popped_sum.fetch_add(sum, std::memory_order_relaxed);
+		});
+	}
+
+	while (ready.load() != producer_count + consumer_count)
+	{
+		std::this_thread::yield();
+	}
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	uint64_t expected_sum = expected_count * (expected_count + 1) / 2;
+	if (popped_count != expected_count || popped_sum != expected_sum)
+	{
+		printf("error: popped %llu items summing to %llu, expected %llu summing to %llu\n",
+			(unsigned long long)popped_count.load(), (unsigned long long)popped_sum.load(),
+			(unsigned long long)expected_count, (unsigned long long)expected_sum);
+		exit(1);
+	}
+
+	return std::chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, const char** argv)
+{
+	int max_threads = std::min(16, int(std::thread::hardware_concurrency()));
+	if (argc > 1)
+	{
+		max_threads = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		g_items_per_producer = atoi(argv[2]);
+	}
+
+	printf("producers consumers   ga_queue ops/s  ga_ring_queue ops/s  ratio\n");
+	for (int producers = 1; producers <= max_threads; producers *= 2)
+	{
+		for (int consumers = 1; consumers <= max_threads; consumers *= 2)
+		{
+			uint64_t ops = uint64_t(producers) * g_items_per_producer;
+			double queue_seconds = run_trial<ga_queue>(producers, consumers);
+			double ring_seconds = run_trial<ga_ring_queue>(producers, consumers);
+			printf("%9d %9d %16.0f %20.0f %6.2f\n",
+				producers,
+				consumers,
+				ops / queue_seconds,
+				ops / ring_seconds,
+				queue_seconds / ring_seconds);
+		}
+	}
+
+	return 0;
+}
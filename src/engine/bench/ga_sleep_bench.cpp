@@ -0,0 +1,173 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Update interval and sleep benchmark.
+** A crowd of props, each an entity with one component that poses a small
+** skeleton, updated by ga_sim. Compares every prop updating every frame
+** with props that pose every fourth frame, or of which 90% are asleep,
+** both ways: by a check in the component, which the sim still calls every
+** frame, and through the sim's schedule. Reports the average and worst
+** frame; the check poses every prop on the same frame, the schedule
+** spreads them out.
+*/
+
+#include "entity/ga_component.h"
+#include "entity/ga_entity.h"
+#include "framework/ga_frame_params.h"
+#include "framework/ga_sim.h"
+#include "jobs/ga_job.h"
+#include "math/ga_mat4f.h"
+#include "math/ga_quatf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+static const int k_bone_count = 16;
+static const uint32_t k_interval = 4;
+static const int k_awake_percent = 10;
+
+static int g_prop_count = 100000;
+static int g_frame_count = 40;
+
+class prop_component : public ga_component
+{
+public:
+	prop_component(ga_entity* ent, bool check_interval, bool check_awake) :
+		ga_component(ent),
+		_check_interval(check_interval),
+		_check_awake(check_awake),
+		_awake(true),
+		_frame(0)
+	{
+		ga_quatf rotation;
+		rotation.make_axis_angle(ga_vec3f::y_vector(), 0.01f);
+		_step.make_rotation(rotation);
+		for (int i = 0; i < k_bone_count; ++i)
+		{
+			_pose[i].make_identity();
+		}
+	}
+
+	virtual void update(ga_frame_params* params) override
+	{
+		_frame++;
+		if (_check_awake && !_awake)
+		{
+			return;
+		}
+		if (_check_interval && _frame % k_interval != 0)
+		{
+			return;
+		}
+
+		for (int i = 0; i < k_bone_count; ++i)
+		{
+			_pose[i] = _step * (i > 0 ? _pose[i - 1] : _pose[i]);
+		}
+	}
+
+	bool _check_interval;
+	bool _check_awake;
+	bool _awake;
+
+private:
+	uint32_t _frame;
+	ga_mat4f _step;
+	ga_mat4f _pose[k_bone_count];
+};
+
+enum prop_mode_t
+{
+	k_every_frame,
+	k_interval_check,
+	k_interval_schedule,
+	k_sleep_check,
+	k_sleep_schedule,
+};
+
+static const char* k_mode_names[] =
+{
+	"every frame",
+	"interval, checked",
+	"interval, scheduled",
+	"90% asleep, checked",
+	"90% asleep, scheduled",
+};
+
+static void run(prop_mode_t mode)
+{
+	ga_sim sim;
+	for (int i = 0; i < g_prop_count; ++i)
+	{
+		ga_entity_handle handle = sim.create_entity();
+		prop_component* prop = new prop_component(sim.get_entity(handle), mode == k_interval_check, mode == k_sleep_check);
+
+		bool awake = i % 100 < k_awake_percent;
+		if (mode == k_interval_schedule)
+		{
+			prop->set_update_interval(k_interval);
+		}
+		else if (mode == k_sleep_check)
+		{
+			prop->_awake = awake;
+		}
+		else if (mode == k_sleep_schedule && !awake)
+		{
+			prop->sleep();
+		}
+	}
+
+	ga_frame_params params;
+	double total_ms = 0.0;
+	double worst_ms = 0.0;
+	for (int frame = 0; frame < g_frame_count + 1; ++frame)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		sim.update(&params);
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		// The first frame plays the schedule changes made above.
+		if (frame > 0)
+		{
+			double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+			total_ms += ms;
+			worst_ms = std::max(worst_ms, ms);
+		}
+	}
+
+	printf("%-24s %10.3f %10.3f\n", k_mode_names[mode], total_ms / g_frame_count, worst_ms);
+}
+
+int main(int argc, const char** argv)
+{
+	if (argc > 1)
+	{
+		g_prop_count = atoi(argv[1]);
+	}
+
+	ga_job_config_t config;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	ga_job::startup(config);
+
+	printf("%d props, %d bones each, interval %u, %d workers, %d frames\n", g_prop_count, k_bone_count, k_interval, ga_job::get_worker_count(), g_frame_count);
+	printf("%-24s %10s %10s\n", "", "average ms", "worst ms");
+	run(k_every_frame);
+	run(k_interval_check);
+	run(k_interval_schedule);
+	run(k_sleep_check);
+	run(k_sleep_schedule);
+
+	ga_job::shutdown();
+	return 0;
+}
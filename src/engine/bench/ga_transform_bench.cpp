@@ -0,0 +1,246 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Transform hierarchy benchmark.
+** Builds 1M nodes, each parent with four children, under 64 roots, and
+** times world matrix updates with 1 to N worker threads: with every node
+** dirty, with 1% of local transforms changed, and with none changed.
+** The baseline is the usual node tree, each node allocated on its own,
+** recomputing every world matrix recursively from the roots.
+** Checks that both agree before timing.
+*/
+
+#include "entity/ga_transform_hierarchy.h"
+#include "jobs/ga_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const int k_root_count = 64;
+static const int k_branching = 4;
+
+static int g_node_count = 1000000;
+static int g_frame_count = 10;
+
+struct naive_node_t
+{
+	ga_vec3f _translation;
+	ga_quatf _rotation;
+	float _scale;
+	ga_mat4f _world;
+	std::vector<naive_node_t*> _children;
+};
+
+static void update_naive(naive_node_t* node, const ga_mat4f& parent_world)
+{
+	ga_mat4f local;
+	local.make_rotation(node->_rotation);
+	for (int row = 0; row < 3; ++row)
+	{
+		local.data[row][0] *= node->_scale;
+		local.data[row][1] *= node->_scale;
+		local.data[row][2] *= node->_scale;
+	}
+	local.data[3][0] = node->_translation.x;
+	local.data[3][1] = node->_translation.y;
+	local.data[3][2] = node->_translation.z;
+
+	node->_world = local * parent_world;
+	for (naive_node_t* child : node->_children)
+	{
+		update_naive(child, node->_world);
+	}
+}
+
+static int get_parent(int node)
+{
+	return node < k_root_count ? -1 : (node - k_root_count) / k_branching;
+}
+
+static ga_quatf make_rotation(float angle)
+{
+	ga_quatf rotation;
+	rotation.make_axis_angle(ga_vec3f::y_vector(), angle);
+	return rotation;
+}
+
+static ga_vec3f make_translation(int node)
+{
+	return { float(node % k_branching), 1.0f, 0.0f };
+}
+
+static float get_ms(std::chrono::high_resolution_clock::time_point t0, std::chrono::high_resolution_clock::time_point t1)
+{
+	return float(std::chrono::duration<double, std::milli>(t1 - t0).count());
+}
+
+struct trial_result_t
+{
+	float _naive_ms;
+	float _full_ms;
+	float _partial_ms;
+	float _clean_ms;
+	uint32_t _partial_count;
+};
+
+static trial_result_t run_trial(int worker_count, const std::vector<int>& changed_nodes)
+{
+	uint32_t mask = worker_count >= 32 ? 0xffffffff : ((1u << worker_count) - 1);
+	ga_job::startup(mask, 1024, 256);
+
+	trial_result_t result = { 1e30f, 1e30f, 1e30f, 1e30f, 0 };
+
+	ga_mat4f identity;
+	identity.make_identity();
+
+	std::vector<naive_node_t*> naive(g_node_count);
+	ga_transform_hierarchy hierarchy;
+	std::vector<ga_transform_id> ids(g_node_count);
+	for (int i = 0; i < g_node_count; ++i)
+	{
+		int parent = get_parent(i);
+
+		naive[i] = new naive_node_t;
+		naive[i]->_translation = make_translation(i);
+		naive[i]->_rotation = make_rotation(0.1f);
+		naive[i]->_scale = 1.0f;
+		if (parent >= 0)
+		{
+			naive[parent]->_children.push_back(naive[i]);
+		}
+
+		ids[i] = hierarchy.add(parent >= 0 ? ids[parent] : k_invalid_transform_id);
+		hierarchy.set_local(ids[i], make_translation(i), make_rotation(0.1f), 1.0f);
+	}
+
+	for (int frame = 0; frame < g_frame_count; ++frame)
+	{
+		float angle = 0.1f + 0.01f * frame;
+		for (int i : changed_nodes)
+		{
+			naive[i]->_rotation = make_rotation(angle);
+		}
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < k_root_count; ++i)
+		{
+			update_naive(naive[i], identity);
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+		result._naive_ms = std::min(result._naive_ms, get_ms(t0, t1));
+	}
+
+	for (int frame = 0; frame < g_frame_count; ++frame)
+	{
+		for (int i = 0; i < g_node_count; ++i)
+		{
+			hierarchy.set_scale(ids[i], 1.0f);
+		}
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		hierarchy.update();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		result._full_ms = std::min(result._full_ms, get_ms(t0, t1));
+	}
+
+	for (int frame = 0; frame < g_frame_count; ++frame)
+	{
+		float angle = 0.1f + 0.01f * frame;
+		for (int i : changed_nodes)
+		{
+			hierarchy.set_rotation(ids[i], make_rotation(angle));
+		}
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		hierarchy.update();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		result._partial_ms = std::min(result._partial_ms, get_ms(t0, t1));
+		result._partial_count = hierarchy.get_last_update_count();
+	}
+
+	for (int frame = 0; frame < g_frame_count; ++frame)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		hierarchy.update();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		result._clean_ms = std::min(result._clean_ms, get_ms(t0, t1));
+	}
+
+	// Both saw the same last frame of changes.
+	for (int i = 0; i < g_node_count; ++i)
+	{
+		const ga_mat4f& world = hierarchy.get_world(ids[i]);
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int col = 0; col < 4; ++col)
+			{
+				if (std::fabs(world.data[row][col] - naive[i]->_world.data[row][col]) > 1e-3f)
+				{
+					printf("error: node %d world differs from the baseline\n", i);
+					exit(1);
+				}
+			}
+		}
+	}
+
+	for (naive_node_t* node : naive)
+	{
+		delete node;
+	}
+
+	ga_job::shutdown();
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	int max_workers = std::min(32, int(std::thread::hardware_concurrency()));
+	if (argc > 1)
+	{
+		max_workers = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		g_node_count = std::max(k_root_count, atoi(argv[2]));
+	}
+
+	// The same 1% of nodes change every frame.
+	std::vector<int> changed_nodes;
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> pick(0, g_node_count - 1);
+	for (int i = 0; i < g_node_count / 100; ++i)
+	{
+		changed_nodes.push_back(pick(random));
+	}
+
+	printf("%d nodes, %d roots, %d children each, best of %d frames\n", g_node_count, k_root_count, k_branching, g_frame_count);
+	printf("workers   naive ms   full ms   1%% ms (updated)   clean ms  full speedup\n");
+	for (int workers = 1; workers <= max_workers; ++workers)
+	{
+		trial_result_t result = run_trial(workers, changed_nodes);
+		printf("%7d %10.2f %9.2f %8.2f (%7u) %10.3f %13.2f\n",
+			workers,
+			result._naive_ms,
+			result._full_ms,
+			result._partial_ms,
+			result._partial_count,
+			result._clean_ms,
+			result._naive_ms / result._full_ms);
+	}
+
+	return 0;
+}
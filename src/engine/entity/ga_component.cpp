@@ -11,6 +11,32 @@
 
 #include "ga_entity.h"
 
+#include "framework/ga_block_pool.h"
+#include "framework/ga_sim.h"
+
+#include <cassert>
+#include <mutex>
+
+// Components up to this size come from a pool per size class; larger ones
+// from the heap.
+static const size_t k_max_pooled_component_size = 1024;
+static const size_t k_pool_count = k_max_pooled_component_size / ga_block_pool::k_alignment;
+
+struct ga_component_pool_t
+{
+	std::mutex _lock;
+	ga_block_pool* _pool = nullptr;
+};
+
+static ga_component_pool_t* _ga_get_component_pool(size_t size)
+{
+	// Never destroyed, so components deleted during shutdown still have a pool.
+	static ga_component_pool_t* pools = new ga_component_pool_t[k_pool_count];
+
+	size_t size_class = (size + ga_block_pool::k_alignment - 1) / ga_block_pool::k_alignment;
+	return size_class <= k_pool_count ? &pools[size_class - 1] : nullptr;
+}
+
 ga_component::ga_component(ga_entity* ent) : _entity(ent)
 {
 	_entity->add_component(this);
@@ -27,3 +53,61 @@ void ga_component::update(ga_frame_params* params)
 void ga_component::late_update(ga_frame_params* params)
 {
 }
+
+void ga_component::set_update_interval(uint32_t interval)
+{
+	assert(interval > 0);
+	_update_interval = interval;
+	reschedule();
+}
+
+void ga_component::sleep()
+{
+	_asleep = true;
+	reschedule();
+}
+
+void ga_component::wake()
+{
+	_asleep = false;
+	reschedule();
+}
+
+void ga_component::reschedule()
+{
+	ga_sim* sim = _entity->get_sim();
+	if (sim)
+	{
+		sim->get_commands()->reschedule(_entity->get_handle(), this);
+	}
+}
+
+void* ga_component::operator new(size_t size)
+{
+	ga_component_pool_t* pool = _ga_get_component_pool(size);
+	if (!pool)
+	{
+		return ::operator new(size);
+	}
+
+	std::lock_guard<std::mutex> lock(pool->_lock);
+	if (!pool->_pool)
+	{
+		size_t size_class = (size + ga_block_pool::k_alignment - 1) / ga_block_pool::k_alignment;
+		pool->_pool = new ga_block_pool(size_class * ga_block_pool::k_alignment);
+	}
+	return pool->_pool->allocate();
+}
+
+void ga_component::operator delete(void* p, size_t size)
+{
+	ga_component_pool_t* pool = _ga_get_component_pool(size);
+	if (!pool)
+	{
+		::operator delete(p);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(pool->_lock);
+	pool->_pool->free(p);
+}
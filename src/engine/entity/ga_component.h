@@ -14,7 +14,15 @@
 /*
 ** Base class component object.
 ** All entity functionality is expected to derive from this object.
+** Components made with new come from pools by size, shared by all types.
+**
+** A component may update less often than every frame, or sleep until it's
+** woken. The sim staggers components with the same interval across frames.
+** Changes take effect at the sim's next frame boundary, so they're safe to
+** make from inside an update.
 ** @see ga_entity
+** @see ga_block_pool
+** @see ga_sim
 */
 class ga_component
 {
@@ -26,9 +34,37 @@ public:
 	virtual void update(struct ga_frame_params* params);
 	virtual void late_update(struct ga_frame_params* params);
 
+	static void* operator new(size_t size);
+	static void operator delete(void* p, size_t size);
+
 	const class ga_entity* get_entity() const { return _entity; }
 	class ga_entity* get_entity() { return _entity; }
 
+	/*
+	** Updates once every interval frames, with params->_delta_time covering
+	** them all. Late update still runs every frame.
+	*/
+	void set_update_interval(uint32_t interval);
+	uint32_t get_update_interval() const { return _update_interval; }
+
+	/*
+	** A sleeping component isn't updated until it's woken. Late update still
+	** runs every frame, so it keeps drawing.
+	*/
+	void sleep();
+	void wake();
+	bool is_asleep() const { return _asleep; }
+
 private:
+	friend class ga_sim;
+
+	void reschedule();
+
 	class ga_entity* _entity;
+
+	uint32_t _update_interval = 1;
+	bool _asleep = false;
+
+	// The sim's schedule entry this component runs in, if any.
+	uint32_t _schedule_unit = 0xffffffff;
 };
@@ -10,7 +10,11 @@
 #include "ga_entity.h"
 #include "ga_component.h"
 
-ga_entity::ga_entity()
+#include "framework/ga_sim.h"
+
+#include <algorithm>
+
+ga_entity::ga_entity() : _sim(nullptr), _handle(k_invalid_entity_handle)
 {
 	_transform.make_identity();
 }
@@ -22,6 +26,29 @@ ga_entity::~ga_entity()
 void ga_entity::add_component(ga_component* comp)
 {
 	_components.push_back(comp);
+	if (_sim)
+	{
+		_sim->schedule_component(this, comp);
+	}
+}
+
+void ga_entity::remove_component(ga_component* comp)
+{
+	auto it = std::find(_components.begin(), _components.end(), comp);
+	if (it != _components.end())
+	{
+		if (_sim)
+		{
+			_sim->unschedule_component(comp);
+		}
+		_components.erase(it);
+	}
+}
+
+void ga_entity::reset()
+{
+	_components.clear();
+	_transform.make_identity();
 }
 
 void ga_entity::update(ga_frame_params* params)
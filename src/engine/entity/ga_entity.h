@@ -11,8 +11,24 @@
 
 #include "math/ga_mat4f.h"
 
+#include <cstdint>
 #include <vector>
 
+/*
+** Names a ga_entity in a ga_sim. When the sim removes an entity its slot is
+** reused with a new generation, so a handle kept past that finds nothing.
+*/
+struct ga_entity_handle
+{
+	uint32_t _index;
+	uint32_t _generation;
+
+	bool operator==(const ga_entity_handle& other) const { return _index == other._index && _generation == other._generation; }
+	bool operator!=(const ga_entity_handle& other) const { return !(*this == other); }
+};
+
+static const ga_entity_handle k_invalid_entity_handle = { 0xffffffff, 0 };
+
 /*
 ** Entity object.
 ** A bucket of components in 3D space. No classes should derive from here.
@@ -26,6 +42,11 @@ public:
 	~ga_entity();
 
 	void add_component(class ga_component* comp);
+	void remove_component(class ga_component* comp);
+	const std::vector<class ga_component*>& get_components() const { return _components; }
+
+	/* Forgets the components, keeping the list's storage, and resets the transform. */
+	void reset();
 
 	void update(struct ga_frame_params* params);
 	void late_update(struct ga_frame_params* params);
@@ -37,7 +58,26 @@ public:
 	const ga_mat4f& get_transform() const { return _transform; }
 	void set_transform(const ga_mat4f& t) { _transform = t; }
 
+	/* The sim that has this entity, if any, and its handle there. */
+	class ga_sim* get_sim() const { return _sim; }
+	ga_entity_handle get_handle() const { return _handle; }
+
 private:
+	friend class ga_sim;
+
 	std::vector<class ga_component*> _components;
 	ga_mat4f _transform;
+	class ga_sim* _sim;
+	ga_entity_handle _handle;
+};
+
+/*
+** Component for a ga_entity_store entity that runs a ga_entity's components,
+** so existing ga_component classes work alongside store components. The
+** ga_entity stays where it is; the store only holds the pointer.
+** @see ga_sim
+*/
+struct ga_entity_adapter
+{
+	ga_entity* _entity;
 };
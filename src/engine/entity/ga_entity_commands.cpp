@@ -0,0 +1,102 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_entity_commands.h"
+#include "ga_component.h"
+
+#include <cassert>
+
+static const size_t k_chunk_size = 4096;
+static const size_t k_payload_alignment = alignof(std::max_align_t);
+
+ga_entity_commands::ga_entity_commands() :
+	_spawn_count(0),
+	_buffer_index(0),
+	_chunk(0),
+	_chunk_offset(0)
+{
+}
+
+ga_entity_commands::~ga_entity_commands()
+{
+	clear();
+	for (char* chunk : _chunks)
+	{
+		::operator delete(chunk);
+	}
+}
+
+ga_entity_handle ga_entity_commands::spawn()
+{
+	assert(_spawn_count <= k_spawn_index_mask);
+
+	ga_entity_handle handle = { (_buffer_index << k_spawn_index_bits) | _spawn_count++, k_spawned_generation };
+	_commands.push_back({ handle, k_command_spawn, nullptr, nullptr, nullptr });
+	return handle;
+}
+
+void ga_entity_commands::despawn(ga_entity_handle handle)
+{
+	_commands.push_back({ handle, k_command_despawn, nullptr, nullptr, nullptr });
+}
+
+void ga_entity_commands::reschedule(ga_entity_handle handle, ga_component* comp)
+{
+	_commands.push_back({ handle, k_command_reschedule, comp, nullptr, discard_nothing });
+}
+
+void ga_entity_commands::remove_component_of_type(ga_entity* ent, const std::type_info& type)
+{
+	for (ga_component* c : ent->get_components())
+	{
+		if (typeid(*c) == type)
+		{
+			ent->remove_component(c);
+			delete c;
+			return;
+		}
+	}
+}
+
+void* ga_entity_commands::allocate_payload(size_t size)
+{
+	size = (size + k_payload_alignment - 1) & ~(k_payload_alignment - 1);
+	assert(size <= k_chunk_size);
+
+	if (_chunk < _chunks.size() && _chunk_offset + size > k_chunk_size)
+	{
+		_chunk++;
+		_chunk_offset = 0;
+	}
+	if (_chunk == _chunks.size())
+	{
+		_chunks.push_back(static_cast<char*>(::operator new(k_chunk_size)));
+	}
+
+	void* payload = _chunks[_chunk] + _chunk_offset;
+	_chunk_offset += size;
+	return payload;
+}
+
+void ga_entity_commands::clear()
+{
+	// Played commands have released their payloads already.
+	for (const command_t& command : _commands)
+	{
+		if (command._payload)
+		{
+			command._discard(command._payload);
+		}
+	}
+	_commands.clear();
+	_spawn_count = 0;
+	_spawned.clear();
+	_chunk = 0;
+	_chunk_offset = 0;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_entity.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+/*
+** Structural changes to a ga_sim's entities, recorded during the frame and
+** made later, all at once. Each worker records into its own buffer, so
+** recording takes no lock; the sim plays every buffer back at the end of
+** late_update, when no job is looking at the entities.
+**
+** spawn returns a handle that only commands understand until playback, in
+** this buffer or any other of the same sim. Despawn removes any entity;
+** the component commands only change entities the sim owns, since the
+** components they add are the sim's to delete and the ones they remove
+** are deleted, and are dropped on others. Commands on an entity gone by
+** playback are dropped too.
+** @see ga_sim::get_commands
+*/
+class ga_entity_commands
+{
+public:
+	ga_entity_commands();
+	~ga_entity_commands();
+
+	ga_entity_commands(const ga_entity_commands&) = delete;
+	ga_entity_commands& operator=(const ga_entity_commands&) = delete;
+
+	ga_entity_handle spawn();
+	void despawn(ga_entity_handle handle);
+
+	/* At playback, news a T(entity, args...); the args are copied now. */
+	template<class T, class... A>
+	void add_component(ga_entity_handle handle, const A&... args);
+
+	/* At playback, deletes the entity's first component whose type is exactly T. */
+	template<class T>
+	void remove_component(ga_entity_handle handle);
+
+	bool empty() const { return _commands.empty(); }
+
+	/* Generation of the handles spawn returns; real entities never get it. */
+	static const uint32_t k_spawned_generation = 0xffffffff;
+
+private:
+	friend class ga_component;
+	friend class ga_sim;
+
+	enum command_type_t : uint8_t
+	{
+		k_command_spawn,
+		k_command_despawn,
+		k_command_add_component,
+		k_command_remove_component,
+		k_command_reschedule,
+	};
+
+	struct command_t
+	{
+		ga_entity_handle _entity;
+		command_type_t _type;
+		void* _payload;
+
+		// Plays the command on its entity, or just releases the payload.
+		void (*_play)(ga_entity* ent, void* payload);
+		void (*_discard)(void* payload);
+	};
+
+	template<class T, class Args, size_t... I>
+	static void construct(ga_entity* ent, Args* args, std::index_sequence<I...>)
+	{
+		// Unused when T takes only the entity.
+		(void)args;
+		new T(ent, std::get<I>(*args)...);
+	}
+
+	template<class T, class... A>
+	static void play_add(ga_entity* ent, void* payload);
+
+	template<class T>
+	static void play_remove(ga_entity* ent, void* payload);
+
+	template<class Args>
+	static void discard(void* payload) { static_cast<Args*>(payload)->~Args(); }
+
+	static void remove_component_of_type(ga_entity* ent, const std::type_info& type);
+	static void discard_nothing(void* payload) {}
+
+	/* At playback, moves the component to the schedule its interval and sleep call for. */
+	void reschedule(ga_entity_handle handle, class ga_component* comp);
+
+	void* allocate_payload(size_t size);
+	void clear();
+
+	// Spawned handles pack the buffer above the buffer's spawn count.
+	static const uint32_t k_spawn_index_bits = 24;
+	static const uint32_t k_spawn_index_mask = (1u << k_spawn_index_bits) - 1;
+
+	std::vector<command_t> _commands;
+
+	// Spawned so far this frame, and at playback the handles they became.
+	uint32_t _spawn_count;
+	std::vector<ga_entity_handle> _spawned;
+
+	// Which buffer of the sim this is, for the handles spawn returns.
+	uint32_t _buffer_index;
+
+	// Command arguments, in chunks kept from frame to frame.
+	std::vector<char*> _chunks;
+	size_t _chunk;
+	size_t _chunk_offset;
+};
+
+template<class T, class... A>
+void ga_entity_commands::add_component(ga_entity_handle handle, const A&... args)
+{
+	typedef std::tuple<A...> args_t;
+	static_assert(alignof(args_t) <= alignof(std::max_align_t), "command arguments can't be aligned");
+
+	void* payload = allocate_payload(sizeof(args_t));
+	new (payload) args_t(args...);
+	_commands.push_back({ handle, k_command_add_component, payload, play_add<T, A...>, discard<args_t> });
+}
+
+template<class T>
+void ga_entity_commands::remove_component(ga_entity_handle handle)
+{
+	_commands.push_back({ handle, k_command_remove_component, nullptr, play_remove<T>, nullptr });
+}
+
+template<class T, class... A>
+void ga_entity_commands::play_add(ga_entity* ent, void* payload)
+{
+	typedef std::tuple<A...> args_t;
+	args_t* args = static_cast<args_t*>(payload);
+	construct<T>(ent, args, std::index_sequence_for<A...>());
+	args->~args_t();
+}
+
+template<class T>
+void ga_entity_commands::play_remove(ga_entity* ent, void* payload)
+{
+	remove_component_of_type(ent, typeid(T));
+}
@@ -0,0 +1,244 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_entity_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+static const uint32_t k_min_archetype_capacity = 16;
+
+// Registered component types. A fixed array, so moving components never
+// races with another thread registering a type.
+static ga_component_type_info_t _ga_component_types[ga_entity_store::k_max_component_types];
+static std::atomic<uint32_t> _ga_component_type_count(0);
+static std::mutex _ga_component_type_lock;
+
+uint32_t ga_entity_store::register_type(const ga_component_type_info_t& info)
+{
+	std::lock_guard<std::mutex> lock(_ga_component_type_lock);
+
+	uint32_t id = _ga_component_type_count.load();
+	if (id >= k_max_component_types)
+	{
+		// Handing back a used id would alias two types' columns; stop here.
+		printf("ga_entity_store: too many component types registering %s; the limit is %u.\n", info._name, k_max_component_types);
+		fflush(stdout);
+		abort();
+	}
+	assert(info._align <= alignof(std::max_align_t));
+
+	_ga_component_types[id] = info;
+	_ga_component_type_count.store(id + 1);
+	return id;
+}
+
+ga_entity_store::ga_entity_store() : _entity_count(0)
+{
+	// Archetype 0 holds entities without components.
+	get_archetype(0);
+}
+
+ga_entity_store::~ga_entity_store()
+{
+	for (archetype_t* archetype : _archetypes)
+	{
+		for (size_t c = 0; c < archetype->_types.size(); ++c)
+		{
+			const ga_component_type_info_t& info = _ga_component_types[archetype->_types[c]];
+			for (uint32_t row = 0; row < archetype->_count; ++row)
+			{
+				info._destroy(archetype->_columns[c] + row * info._size);
+			}
+			::operator delete(archetype->_columns[c]);
+		}
+		delete archetype;
+	}
+}
+
+ga_entity_id ga_entity_store::create()
+{
+	uint32_t index;
+	if (!_free_records.empty())
+	{
+		index = _free_records.back();
+		_free_records.pop_back();
+	}
+	else
+	{
+		index = uint32_t(_records.size());
+		_records.push_back({ 0, 0, 0 });
+	}
+
+	ga_entity_id id = { index, _records[index]._generation };
+
+	archetype_t* empty = _archetypes[0];
+	if (empty->_count == empty->_capacity)
+	{
+		grow(empty);
+	}
+	uint32_t row = empty->_count++;
+	empty->_ids[row] = id;
+
+	_records[index]._archetype = 0;
+	_records[index]._row = row;
+	_entity_count++;
+	return id;
+}
+
+void ga_entity_store::destroy(ga_entity_id id)
+{
+	if (!find(id))
+	{
+		return;
+	}
+
+	entity_record_t& record = _records[id._index];
+	archetype_t* archetype = _archetypes[record._archetype];
+	for (size_t c = 0; c < archetype->_types.size(); ++c)
+	{
+		const ga_component_type_info_t& info = _ga_component_types[archetype->_types[c]];
+		info._destroy(archetype->_columns[c] + record._row * info._size);
+	}
+	remove_row(archetype, record._row);
+
+	record._generation++;
+	_free_records.push_back(id._index);
+	_entity_count--;
+}
+
+bool ga_entity_store::is_alive(ga_entity_id id) const
+{
+	return find(id) != nullptr;
+}
+
+const ga_entity_store::entity_record_t* ga_entity_store::find(ga_entity_id id) const
+{
+	if (id._index >= _records.size() || _records[id._index]._generation != id._generation)
+	{
+		return nullptr;
+	}
+	return &_records[id._index];
+}
+
+ga_entity_store::archetype_t* ga_entity_store::get_archetype(uint64_t mask)
+{
+	auto it = _archetype_of_mask.find(mask);
+	if (it != _archetype_of_mask.end())
+	{
+		return _archetypes[it->second];
+	}
+
+	archetype_t* archetype = new archetype_t;
+	archetype->_mask = mask;
+	archetype->_count = 0;
+	archetype->_capacity = 0;
+	memset(archetype->_column_of_type, -1, sizeof(archetype->_column_of_type));
+	for (uint32_t type = 0; type < k_max_component_types; ++type)
+	{
+		if (mask & (uint64_t(1) << type))
+		{
+			archetype->_column_of_type[type] = int8_t(archetype->_types.size());
+			archetype->_types.push_back(type);
+			archetype->_columns.push_back(nullptr);
+		}
+	}
+
+	_archetype_of_mask[mask] = uint32_t(_archetypes.size());
+	_archetypes.push_back(archetype);
+	return archetype;
+}
+
+void* ga_entity_store::move_entity(ga_entity_id id, uint64_t mask, uint32_t type)
+{
+	entity_record_t& record = _records[id._index];
+	archetype_t* from = _archetypes[record._archetype];
+	const ga_component_type_info_t& type_info = _ga_component_types[type];
+
+	if (from->_mask == mask)
+	{
+		int column = from->_column_of_type[type];
+		return column >= 0 ? from->_columns[column] + record._row * type_info._size : nullptr;
+	}
+
+	archetype_t* to = get_archetype(mask);
+	if (to->_count == to->_capacity)
+	{
+		grow(to);
+	}
+	uint32_t row = to->_count++;
+	to->_ids[row] = id;
+
+	// Carry over the components both archetypes have; drop the rest.
+	for (size_t c = 0; c < from->_types.size(); ++c)
+	{
+		const ga_component_type_info_t& info = _ga_component_types[from->_types[c]];
+		char* source = from->_columns[c] + record._row * info._size;
+
+		int to_column = to->_column_of_type[from->_types[c]];
+		if (to_column >= 0)
+		{
+			info._move(to->_columns[to_column] + row * info._size, source);
+		}
+		info._destroy(source);
+	}
+	remove_row(from, record._row);
+
+	record._archetype = _archetype_of_mask[mask];
+	record._row = row;
+
+	// A new component's slot is left for the caller to construct.
+	int column = to->_column_of_type[type];
+	return column >= 0 ? to->_columns[column] + row * type_info._size : nullptr;
+}
+
+void ga_entity_store::grow(archetype_t* archetype)
+{
+	uint32_t capacity = std::max(k_min_archetype_capacity, archetype->_capacity * 2);
+
+	for (size_t c = 0; c < archetype->_types.size(); ++c)
+	{
+		const ga_component_type_info_t& info = _ga_component_types[archetype->_types[c]];
+		char* column = static_cast<char*>(::operator new(capacity * info._size));
+		for (uint32_t row = 0; row < archetype->_count; ++row)
+		{
+			info._move(column + row * info._size, archetype->_columns[c] + row * info._size);
+			info._destroy(archetype->_columns[c] + row * info._size);
+		}
+		::operator delete(archetype->_columns[c]);
+		archetype->_columns[c] = column;
+	}
+
+	archetype->_ids.resize(capacity);
+	archetype->_capacity = capacity;
+}
+
+void ga_entity_store::remove_row(archetype_t* archetype, uint32_t row)
+{
+	// The row's components are already gone; fill the hole with the last row.
+	uint32_t last = archetype->_count - 1;
+	if (row != last)
+	{
+		for (size_t c = 0; c < archetype->_types.size(); ++c)
+		{
+			const ga_component_type_info_t& info = _ga_component_types[archetype->_types[c]];
+			info._move(archetype->_columns[c] + row * info._size, archetype->_columns[c] + last * info._size);
+			info._destroy(archetype->_columns[c] + last * info._size);
+		}
+
+		ga_entity_id moved = archetype->_ids[last];
+		archetype->_ids[row] = moved;
+		_records[moved._index]._row = row;
+	}
+	archetype->_count--;
+}
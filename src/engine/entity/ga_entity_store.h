@@ -0,0 +1,262 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "jobs/ga_job.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+** Names an entity in a ga_entity_store. When an entity is destroyed its slot
+** is reused with a new generation, so an id kept past that finds nothing.
+*/
+struct ga_entity_id
+{
+	uint32_t _index;
+	uint32_t _generation;
+
+	bool operator==(const ga_entity_id& other) const { return _index == other._index && _generation == other._generation; }
+	bool operator!=(const ga_entity_id& other) const { return !(*this == other); }
+};
+
+static const ga_entity_id k_invalid_entity_id = { 0xffffffff, 0 };
+
+/*
+** How the store moves and destroys a component type it knows only by id.
+*/
+struct ga_component_type_info_t
+{
+	const char* _name;
+	size_t _size;
+	size_t _align;
+	void (*_move)(void* dest, void* source);
+	void (*_destroy)(void* component);
+};
+
+/*
+** Entity storage that keeps components by value, in one array per type.
+** Entities with the same set of component types share an archetype, whose
+** arrays line up row by row, so a query walks plain arrays instead of
+** chasing a pointer per component.
+**
+** Component types are plain movable structs; no base class. Up to
+** k_max_component_types of them may be used; registering one more aborts.
+** Adding or removing a component moves the entity's row to another
+** archetype, so component pointers last only until the next structural
+** change: create, destroy, add or remove.
+** Those aren't thread safe and mustn't happen during a query. Queries may
+** modify the components they visit.
+*/
+class ga_entity_store
+{
+public:
+	ga_entity_store();
+	~ga_entity_store();
+
+	ga_entity_store(const ga_entity_store&) = delete;
+	ga_entity_store& operator=(const ga_entity_store&) = delete;
+
+	ga_entity_id create();
+	void destroy(ga_entity_id id);
+	bool is_alive(ga_entity_id id) const;
+
+	uint32_t get_entity_count() const { return _entity_count; }
+
+	/* Adds a component, or replaces one of the same type. */
+	template<class T>
+	T* add(ga_entity_id id, T component = T());
+
+	template<class T>
+	void remove(ga_entity_id id);
+
+	/* Returns null if the entity is gone or has no such component. */
+	template<class T>
+	T* get(ga_entity_id id);
+
+	/* Calls func(ga_entity_id, T&...) for every entity with all of the types. */
+	template<class... T, class F>
+	void for_each(const F& func);
+
+	/* As for_each, with each archetype's rows split into job batches. */
+	template<class... T, class F>
+	void parallel_for_each(int batch_size, const F& func, ga_job_priority_t priority = k_job_priority_normal);
+
+	template<class T>
+	static uint32_t get_type_id();
+
+	static const uint32_t k_max_component_types = 64;
+
+private:
+	struct archetype_t
+	{
+		uint64_t _mask;
+		uint32_t _count;
+		uint32_t _capacity;
+		std::vector<ga_entity_id> _ids;
+
+		// One array per type in the mask, and the array for each type id.
+		std::vector<uint32_t> _types;
+		std::vector<char*> _columns;
+		int8_t _column_of_type[k_max_component_types];
+	};
+
+	struct entity_record_t
+	{
+		uint32_t _generation;
+		uint32_t _archetype;
+		uint32_t _row;
+	};
+
+	static uint32_t register_type(const ga_component_type_info_t& info);
+
+	template<class T>
+	static ga_component_type_info_t make_type_info();
+
+	template<class T>
+	static uint64_t get_mask() { return uint64_t(1) << get_type_id<T>(); }
+
+	template<class T0, class T1, class... T>
+	static uint64_t get_mask() { return get_mask<T0>() | get_mask<T1, T...>(); }
+
+	template<class T>
+	static T* get_column(archetype_t* archetype) { return reinterpret_cast<T*>(archetype->_columns[archetype->_column_of_type[get_type_id<T>()]]); }
+
+	template<class F, class... T>
+	static void run_rows(const F& func, const ga_entity_id* ids, uint32_t begin, uint32_t end, T*... columns)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			func(ids[i], columns[i]...);
+		}
+	}
+
+	template<class F, class... T>
+	static void run_rows_parallel(const F& func, const ga_entity_id* ids, uint32_t count, int batch_size, ga_job_priority_t priority, T*... columns)
+	{
+		ga_job::parallel_for(0, int(count), batch_size, [&func, ids, columns...](int begin, int end)
+		{
+			run_rows(func, ids, uint32_t(begin), uint32_t(end), columns...);
+		},
+		priority);
+	}
+
+	const entity_record_t* find(ga_entity_id id) const;
+	archetype_t* get_archetype(uint64_t mask);
+
+	/* Moves the entity to the archetype for mask and returns its component of type, if it has one. */
+	void* move_entity(ga_entity_id id, uint64_t mask, uint32_t type);
+	void grow(archetype_t* archetype);
+	void remove_row(archetype_t* archetype, uint32_t row);
+
+	std::vector<archetype_t*> _archetypes;
+	std::unordered_map<uint64_t, uint32_t> _archetype_of_mask;
+
+	std::vector<entity_record_t> _records;
+	std::vector<uint32_t> _free_records;
+	uint32_t _entity_count;
+};
+
+template<class T>
+ga_component_type_info_t ga_entity_store::make_type_info()
+{
+	ga_component_type_info_t info;
+	info._name = typeid(T).name();
+	info._size = sizeof(T);
+	info._align = alignof(T);
+	info._move = [](void* dest, void* source) { new (dest) T(std::move(*static_cast<T*>(source))); };
+	info._destroy = [](void* component) { static_cast<T*>(component)->~T(); };
+	return info;
+}
+
+template<class T>
+uint32_t ga_entity_store::get_type_id()
+{
+	static const uint32_t id = register_type(make_type_info<T>());
+	return id;
+}
+
+template<class T>
+T* ga_entity_store::add(ga_entity_id id, T component)
+{
+	const entity_record_t* record = find(id);
+	assert(record);
+
+	uint32_t type = get_type_id<T>();
+	uint64_t mask = _archetypes[record->_archetype]->_mask;
+	if (mask & get_mask<T>())
+	{
+		T* existing = static_cast<T*>(move_entity(id, mask, type));
+		*existing = std::move(component);
+		return existing;
+	}
+
+	void* storage = move_entity(id, mask | get_mask<T>(), type);
+	return new (storage) T(std::move(component));
+}
+
+template<class T>
+void ga_entity_store::remove(ga_entity_id id)
+{
+	const entity_record_t* record = find(id);
+	assert(record);
+
+	uint64_t mask = _archetypes[record->_archetype]->_mask;
+	if (mask & get_mask<T>())
+	{
+		move_entity(id, mask & ~get_mask<T>(), get_type_id<T>());
+	}
+}
+
+template<class T>
+T* ga_entity_store::get(ga_entity_id id)
+{
+	const entity_record_t* record = find(id);
+	if (!record)
+	{
+		return nullptr;
+	}
+
+	archetype_t* archetype = _archetypes[record->_archetype];
+	int column = archetype->_column_of_type[get_type_id<T>()];
+	return column >= 0 ? reinterpret_cast<T*>(archetype->_columns[column]) + record->_row : nullptr;
+}
+
+template<class... T, class F>
+void ga_entity_store::for_each(const F& func)
+{
+	uint64_t mask = get_mask<T...>();
+	for (archetype_t* archetype : _archetypes)
+	{
+		if ((archetype->_mask & mask) == mask && archetype->_count)
+		{
+			run_rows(func, archetype->_ids.data(), 0, archetype->_count, get_column<T>(archetype)...);
+		}
+	}
+}
+
+template<class... T, class F>
+void ga_entity_store::parallel_for_each(int batch_size, const F& func, ga_job_priority_t priority)
+{
+	uint64_t mask = get_mask<T...>();
+	for (archetype_t* archetype : _archetypes)
+	{
+		if ((archetype->_mask & mask) == mask && archetype->_count)
+		{
+			run_rows_parallel(func, archetype->_ids.data(), archetype->_count, batch_size, priority, get_column<T>(archetype)...);
+		}
+	}
+}
@@ -0,0 +1,299 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_transform_hierarchy.h"
+
+#include "jobs/ga_job.h"
+#include "jobs/ga_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+static const int k_default_batch_size = 4096;
+
+ga_transform_hierarchy::ga_transform_hierarchy() :
+	_node_count(0),
+	_last_update_count(0),
+	_batch_size(k_default_batch_size)
+{
+}
+
+ga_transform_hierarchy::~ga_transform_hierarchy()
+{
+}
+
+ga_transform_id ga_transform_hierarchy::add(ga_transform_id parent)
+{
+	uint32_t level_index = 0;
+	uint32_t parent_index = 0;
+	if (parent != k_invalid_transform_id)
+	{
+		const slot_t* parent_slot = find(parent);
+		assert(parent_slot);
+		level_index = parent_slot->_level + 1;
+		parent_index = parent_slot->_index;
+		_levels[parent_slot->_level]._child_count[parent_index]++;
+	}
+
+	if (level_index == _levels.size())
+	{
+		_levels.emplace_back();
+		_levels.back()._any_changed = false;
+	}
+	level_t& level = _levels[level_index];
+
+	uint32_t slot_index;
+	if (!_free_slots.empty())
+	{
+		slot_index = _free_slots.back();
+		_free_slots.pop_back();
+	}
+	else
+	{
+		slot_index = uint32_t(_slots.size());
+		_slots.push_back({ 0, 0, 0 });
+	}
+	slot_t& slot = _slots[slot_index];
+	slot._level = level_index;
+	slot._index = uint32_t(level._parent.size());
+
+	ga_mat4f identity;
+	identity.make_identity();
+
+	level._translation.push_back({ 0.0f, 0.0f, 0.0f });
+	level._rotation.push_back({ 0.0f, 0.0f, 0.0f, 1.0f });
+	level._scale.push_back(1.0f);
+	level._world.push_back(identity);
+	level._parent.push_back(parent_index);
+	level._child_count.push_back(0);
+	level._dirty.push_back(1);
+	level._changed.push_back(0);
+	level._slot.push_back(slot_index);
+
+	_node_count++;
+	return { slot_index, slot._generation };
+}
+
+void ga_transform_hierarchy::remove(ga_transform_id id)
+{
+	const slot_t* slot = find(id);
+	if (!slot)
+	{
+		return;
+	}
+
+	level_t& level = _levels[slot->_level];
+	uint32_t index = slot->_index;
+	assert(level._child_count[index] == 0);
+
+	if (slot->_level > 0)
+	{
+		_levels[slot->_level - 1]._child_count[level._parent[index]]--;
+	}
+
+	// Move the level's last node into the hole.
+	uint32_t last = uint32_t(level._parent.size()) - 1;
+	if (index != last)
+	{
+		level._translation[index] = level._translation[last];
+		level._rotation[index] = level._rotation[last];
+		level._scale[index] = level._scale[last];
+		level._world[index] = level._world[last];
+		level._parent[index] = level._parent[last];
+		level._child_count[index] = level._child_count[last];
+		level._dirty[index] = level._dirty[last];
+		level._changed[index] = level._changed[last];
+		level._slot[index] = level._slot[last];
+		_slots[level._slot[index]]._index = index;
+
+		// Its children refer to it by index.
+		if (level._child_count[index] && slot->_level + 1 < _levels.size())
+		{
+			for (uint32_t& parent : _levels[slot->_level + 1]._parent)
+			{
+				if (parent == last)
+				{
+					parent = index;
+				}
+			}
+		}
+	}
+
+	level._translation.pop_back();
+	level._rotation.pop_back();
+	level._scale.pop_back();
+	level._world.pop_back();
+	level._parent.pop_back();
+	level._child_count.pop_back();
+	level._dirty.pop_back();
+	level._changed.pop_back();
+	level._slot.pop_back();
+
+	_slots[id._index]._generation++;
+	_free_slots.push_back(id._index);
+	_node_count--;
+}
+
+bool ga_transform_hierarchy::is_valid(ga_transform_id id) const
+{
+	return find(id) != nullptr;
+}
+
+const ga_transform_hierarchy::slot_t* ga_transform_hierarchy::find(ga_transform_id id) const
+{
+	if (id._index >= _slots.size() || _slots[id._index]._generation != id._generation)
+	{
+		return nullptr;
+	}
+	return &_slots[id._index];
+}
+
+void ga_transform_hierarchy::set_local(ga_transform_id id, const ga_vec3f& translation, const ga_quatf& rotation, float scale)
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	level_t& level = _levels[slot->_level];
+	level._translation[slot->_index] = translation;
+	level._rotation[slot->_index] = rotation;
+	level._scale[slot->_index] = scale;
+	level._dirty[slot->_index] = 1;
+}
+
+void ga_transform_hierarchy::set_translation(ga_transform_id id, const ga_vec3f& translation)
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	_levels[slot->_level]._translation[slot->_index] = translation;
+	_levels[slot->_level]._dirty[slot->_index] = 1;
+}
+
+void ga_transform_hierarchy::set_rotation(ga_transform_id id, const ga_quatf& rotation)
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	_levels[slot->_level]._rotation[slot->_index] = rotation;
+	_levels[slot->_level]._dirty[slot->_index] = 1;
+}
+
+void ga_transform_hierarchy::set_scale(ga_transform_id id, float scale)
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	_levels[slot->_level]._scale[slot->_index] = scale;
+	_levels[slot->_level]._dirty[slot->_index] = 1;
+}
+
+const ga_vec3f& ga_transform_hierarchy::get_translation(ga_transform_id id) const
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	return _levels[slot->_level]._translation[slot->_index];
+}
+
+const ga_quatf& ga_transform_hierarchy::get_rotation(ga_transform_id id) const
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	return _levels[slot->_level]._rotation[slot->_index];
+}
+
+float ga_transform_hierarchy::get_scale(ga_transform_id id) const
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	return _levels[slot->_level]._scale[slot->_index];
+}
+
+const ga_mat4f& ga_transform_hierarchy::get_world(ga_transform_id id) const
+{
+	const slot_t* slot = find(id);
+	assert(slot);
+	return _levels[slot->_level]._world[slot->_index];
+}
+
+uint32_t ga_transform_hierarchy::update_range(level_t* level, const level_t* parent_level, uint32_t begin, uint32_t end)
+{
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		bool changed = level->_dirty[i] || (parent_level && parent_level->_changed[level->_parent[i]]);
+		level->_changed[i] = changed;
+		if (!changed)
+		{
+			continue;
+		}
+
+		// Scale, then rotate, then translate, for row vectors as elsewhere.
+		ga_mat4f local;
+		local.make_rotation(level->_rotation[i]);
+		float scale = level->_scale[i];
+		for (int row = 0; row < 3; ++row)
+		{
+			local.data[row][0] *= scale;
+			local.data[row][1] *= scale;
+			local.data[row][2] *= scale;
+		}
+		local.data[3][0] = level->_translation[i].x;
+		local.data[3][1] = level->_translation[i].y;
+		local.data[3][2] = level->_translation[i].z;
+
+		level->_world[i] = parent_level ? local * parent_level->_world[level->_parent[i]] : local;
+		level->_dirty[i] = 0;
+		count++;
+	}
+	return count;
+}
+
+void ga_transform_hierarchy::update()
+{
+	GA_PROFILE_SCOPE("ga_transform_hierarchy::update");
+
+	_last_update_count = 0;
+	bool parent_changed = false;
+	for (size_t l = 0; l < _levels.size(); ++l)
+	{
+		level_t* level = &_levels[l];
+		const level_t* parent_level = l > 0 ? &_levels[l - 1] : nullptr;
+		uint32_t node_count = uint32_t(level->_parent.size());
+
+		// Nothing to do unless a parent moved or a node here was set.
+		if (!parent_changed && std::find(level->_dirty.begin(), level->_dirty.end(), 1) == level->_dirty.end())
+		{
+			if (level->_any_changed)
+			{
+				// Clear what the last update left, so children don't follow it.
+				std::fill(level->_changed.begin(), level->_changed.end(), 0);
+				level->_any_changed = false;
+			}
+			parent_changed = false;
+			continue;
+		}
+
+		uint32_t changed_count = 0;
+		if (int(node_count) <= _batch_size)
+		{
+			changed_count = update_range(level, parent_level, 0, node_count);
+		}
+		else
+		{
+			std::atomic<uint32_t> count(0);
+			ga_job::parallel_for(0, int(node_count), _batch_size, [level, parent_level, &count](int begin, int end)
+			{
+				count.fetch_add(update_range(level, parent_level, uint32_t(begin), uint32_t(end)), std::memory_order_relaxed);
+			},
+			k_job_priority_critical);
+			changed_count = count.load();
+		}
+
+		level->_any_changed = changed_count > 0;
+		parent_changed = level->_any_changed;
+		_last_update_count += changed_count;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "math/ga_mat4f.h"
+#include "math/ga_quatf.h"
+#include "math/ga_vec3f.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+** Names a node in a ga_transform_hierarchy. Removed nodes' slots are reused
+** with a new generation, so an id kept past removal finds nothing.
+*/
+struct ga_transform_id
+{
+	uint32_t _index;
+	uint32_t _generation;
+
+	bool operator==(const ga_transform_id& other) const { return _index == other._index && _generation == other._generation; }
+	bool operator!=(const ga_transform_id& other) const { return !(*this == other); }
+};
+
+static const ga_transform_id k_invalid_transform_id = { 0xffffffff, 0 };
+
+/*
+** Parent/child transforms: each node has a local translation, rotation and
+** uniform scale, and a world matrix cached from them and its parent's.
+**
+** Nodes are stored by depth, a level per depth with each field in its own
+** array, so update walks each level front to back after its parents'
+** level is done. Levels are split into job batches. Setting a local
+** transform marks the node dirty; update recomputes dirty nodes and their
+** descendants only, and passes over levels with nothing to do.
+**
+** Not thread safe, except that different nodes' local transforms may be set
+** from different jobs, outside update.
+*/
+class ga_transform_hierarchy
+{
+public:
+	ga_transform_hierarchy();
+	~ga_transform_hierarchy();
+
+	/* Adds a node under parent, or a root; its local transform is identity. */
+	ga_transform_id add(ga_transform_id parent = k_invalid_transform_id);
+
+	/* Removes a node, which must have no children. */
+	void remove(ga_transform_id id);
+
+	bool is_valid(ga_transform_id id) const;
+
+	void set_local(ga_transform_id id, const ga_vec3f& translation, const ga_quatf& rotation, float scale);
+	void set_translation(ga_transform_id id, const ga_vec3f& translation);
+	void set_rotation(ga_transform_id id, const ga_quatf& rotation);
+	void set_scale(ga_transform_id id, float scale);
+
+	const ga_vec3f& get_translation(ga_transform_id id) const;
+	const ga_quatf& get_rotation(ga_transform_id id) const;
+	float get_scale(ga_transform_id id) const;
+
+	/* World matrix as of the last update. */
+	const ga_mat4f& get_world(ga_transform_id id) const;
+
+	/* Recomputes the world matrices of dirty nodes and their descendants. */
+	void update();
+
+	uint32_t get_node_count() const { return _node_count; }
+	uint32_t get_level_count() const { return uint32_t(_levels.size()); }
+
+	/* World matrices the last update recomputed. */
+	uint32_t get_last_update_count() const { return _last_update_count; }
+
+	/* Nodes per job batch; levels smaller than one batch update inline. */
+	void set_batch_size(int batch_size) { _batch_size = batch_size; }
+
+private:
+	struct level_t
+	{
+		std::vector<ga_vec3f> _translation;
+		std::vector<ga_quatf> _rotation;
+		std::vector<float> _scale;
+		std::vector<ga_mat4f> _world;
+
+		// Index of each node's parent in the level above.
+		std::vector<uint32_t> _parent;
+		std::vector<uint32_t> _child_count;
+
+		// Local transform set since the last update; world recomputed by
+		// the current one, which tells the next level to follow.
+		std::vector<uint8_t> _dirty;
+		std::vector<uint8_t> _changed;
+
+		// Each node's slot, to fix it up when nodes move within the level.
+		std::vector<uint32_t> _slot;
+
+		// Whether the current update changed any node.
+		bool _any_changed;
+	};
+
+	struct slot_t
+	{
+		uint32_t _generation;
+		uint32_t _level;
+		uint32_t _index;
+	};
+
+	const slot_t* find(ga_transform_id id) const;
+
+	static uint32_t update_range(level_t* level, const level_t* parent_level, uint32_t begin, uint32_t end);
+
+	std::vector<level_t> _levels;
+	std::vector<slot_t> _slots;
+	std::vector<uint32_t> _free_slots;
+
+	uint32_t _node_count;
+	uint32_t _last_update_count;
+	int _batch_size;
+};
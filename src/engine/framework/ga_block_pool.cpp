@@ -0,0 +1,64 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_block_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+ga_block_pool::ga_block_pool(size_t item_size, uint32_t items_per_block) :
+	_items_per_block(items_per_block),
+	_block_used(items_per_block),
+	_free_list(nullptr),
+	_allocated_count(0)
+{
+	assert(items_per_block > 0);
+
+	// Room for the free list link, and every item stays aligned.
+	item_size = std::max(item_size, sizeof(free_item_t));
+	_item_size = (item_size + k_alignment - 1) & ~(k_alignment - 1);
+}
+
+ga_block_pool::~ga_block_pool()
+{
+	assert(_allocated_count == 0);
+	for (char* block : _blocks)
+	{
+		::operator delete(block);
+	}
+}
+
+void* ga_block_pool::allocate()
+{
+	_allocated_count++;
+
+	if (_free_list)
+	{
+		free_item_t* item = _free_list;
+		_free_list = item->_next;
+		return item;
+	}
+
+	if (_block_used == _items_per_block)
+	{
+		_blocks.push_back(static_cast<char*>(::operator new(_item_size * _items_per_block)));
+		_block_used = 0;
+	}
+	return _blocks.back() + _item_size * _block_used++;
+}
+
+void ga_block_pool::free(void* item)
+{
+	assert(_allocated_count > 0);
+	_allocated_count--;
+
+	free_item_t* free_item = static_cast<free_item_t*>(item);
+	free_item->_next = _free_list;
+	_free_list = free_item;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+** Fixed size allocator for objects that come and go.
+** Items are carved from blocks of items_per_block at a time, and freed
+** items go on a list threaded through their own storage, so allocate and
+** free are O(1) and, once a block has room, never touch the heap. Blocks
+** are only released when the pool is, so items never move.
+**
+** Not thread safe.
+*/
+class ga_block_pool
+{
+public:
+	ga_block_pool(size_t item_size, uint32_t items_per_block = 256);
+	~ga_block_pool();
+
+	ga_block_pool(const ga_block_pool&) = delete;
+	ga_block_pool& operator=(const ga_block_pool&) = delete;
+
+	/* Returns storage aligned to k_alignment. */
+	void* allocate();
+	void free(void* item);
+
+	size_t get_item_size() const { return _item_size; }
+	uint32_t get_allocated_count() const { return _allocated_count; }
+
+	static const size_t k_alignment = alignof(std::max_align_t);
+
+private:
+	struct free_item_t
+	{
+		free_item_t* _next;
+	};
+
+	size_t _item_size;
+	uint32_t _items_per_block;
+
+	std::vector<char*> _blocks;
+	uint32_t _block_used;
+	free_item_t* _free_list;
+	uint32_t _allocated_count;
+};
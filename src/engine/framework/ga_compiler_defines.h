@@ -14,6 +14,8 @@
 #define GA_MSVC
 #elif defined(__MINGW32__)
 #define GA_MINGW
+#elif defined(__linux__)
+#define GA_LINUX
 #endif
 
 // Architecture.
@@ -33,3 +35,18 @@
 #define GA_32_BIT
 #endif
 #endif
+
+#if defined(GA_LINUX)
+#if defined(__x86_64__) || defined(__aarch64__)
+#define GA_64_BIT
+#else
+#define GA_32_BIT
+#endif
+#endif
+
+// Function attributes.
+#if defined(GA_MSVC)
+#define GA_NOINLINE __declspec(noinline)
+#else
+#define GA_NOINLINE __attribute__((noinline))
+#endif
@@ -9,47 +9,87 @@
 ** This file is distributed under the MIT License. See LICENSE.txt.
 */
 
+#include "ga_frame_arena.h"
 #include "math/ga_mat4f.h"
 #include "math/ga_vec2f.h"
 #include "math/ga_vec3f.h"
 
-#include <string>
-#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
 /*
 ** A draw emitted from the simulation phase and rendered in the output phase.
+** Anything a draw points to must last until the frame is drawn; per-frame
+** data goes in the frame's arena.
 ** @see ga_frame_params
 */
 struct ga_drawcall
 {
-	std::string _name;
+	const char* _name = "";
 	ga_mat4f _transform;
 	GLenum _draw_mode;
 	class ga_material* _material = 0;
 };
 
 /*
-** Draw call with static geometry.
-** The vertex array object referenced by this draw call should live for at
-** least several frames, and probably longer.
+** Draw of static geometry, small enough to copy and sort freely.
+** The vertex array object it references should live for at least several
+** frames, and probably longer. Matrices live in the transform array of the
+** bucket the packet was added to.
+** @see ga_frame_params::add_draw_packet
 */
-struct ga_static_drawcall : ga_drawcall
+struct ga_draw_packet
 {
+	// Output draws packets in key order; see ga_draw_sort_key.
+	uint64_t _sort_key;
+
+	uint32_t _name;       // From ga_name_table.
+	uint32_t _material;   // From ga_material::get_id.
 	GLuint _vao;
 	GLsizei _index_count;
+	GLenum _draw_mode;
+
+	// Object transform, then skinning matrices as of when the draw was
+	// emitted, since the sim may already be posing the skeleton for a later
+	// frame when this is drawn.
+	uint32_t _transform;
+	uint32_t _skin;
+	uint32_t _skin_count;
 };
 
+static_assert(std::is_trivially_copyable<ga_draw_packet>::value, "draw packets are copied and sorted as plain data");
+
+/*
+** Key that orders draws by material, then vertex array, then front to back,
+** so output changes state as little as it can and later draws fail the depth
+** test early. Material takes the top 16 bits, the vertex array the next 24,
+** and view depth the low 24.
+*/
+inline uint64_t ga_draw_sort_key(uint32_t material, GLuint vao, float depth)
+{
+	// A positive float's bits order like the float; take the top 24 below the sign.
+	depth = depth > 0.0f ? depth : 0.0f;
+	uint32_t depth_bits;
+	memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+	return (uint64_t(material & 0xffff) << 48) | (uint64_t(vao & 0xffffff) << 24) | (depth_bits >> 7);
+}
+
 /*
 ** Draw call with dynamic geometry.
-** Geometry referenced by this draw call should only a single frame.
+** Geometry referenced by this draw call should only a single frame, so it's
+** allocated from the frame's arena.
 */
 struct ga_dynamic_drawcall : ga_drawcall
 {
-	std::vector<ga_vec3f> _positions;
-	std::vector<ga_vec2f> _texcoords;
-	std::vector<uint16_t> _indices;
+	ga_dynamic_drawcall(ga_frame_arena* arena) : _positions(arena), _texcoords(arena), _indices(arena) {}
+
+	ga_frame_vector<ga_vec3f> _positions;
+	ga_frame_vector<ga_vec2f> _texcoords;
+	ga_frame_vector<uint16_t> _indices;
 	ga_vec3f _color;
 };
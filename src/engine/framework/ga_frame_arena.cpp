@@ -0,0 +1,74 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_frame_arena.h"
+
+#include <algorithm>
+#include <cassert>
+
+ga_frame_arena::ga_frame_arena(size_t capacity) :
+	_capacity(capacity),
+	_offset(0),
+	_high_water(0)
+{
+	assert(_capacity > 0);
+	_base = static_cast<char*>(::operator new(_capacity));
+	assert((uintptr_t(_base) & (k_alignment - 1)) == 0);
+}
+
+ga_frame_arena::~ga_frame_arena()
+{
+	reset();
+	::operator delete(_base);
+}
+
+void* ga_frame_arena::allocate(size_t size)
+{
+	size = (size + k_alignment - 1) & ~(k_alignment - 1);
+
+	size_t offset = _offset.fetch_add(size, std::memory_order_relaxed);
+	if (offset + size <= _capacity)
+	{
+		return _base + offset;
+	}
+
+	// Out of room this frame. The offset keeps counting, so reset knows how
+	// much the frame wanted.
+	void* block = ::operator new(size);
+	assert((uintptr_t(block) & (k_alignment - 1)) == 0);
+
+	std::lock_guard<std::mutex> lock(_overflow_lock);
+	_overflow.push_back(block);
+	return block;
+}
+
+void ga_frame_arena::reset()
+{
+	for (void* block : _overflow)
+	{
+		::operator delete(block);
+	}
+	_overflow.clear();
+
+	size_t used = _offset.load(std::memory_order_relaxed);
+	_high_water = std::max(_high_water, used);
+
+	// Grow to fit what the frame wanted, with room to spare.
+	if (used > _capacity)
+	{
+		while (_capacity < used)
+		{
+			_capacity *= 2;
+		}
+		::operator delete(_base);
+		_base = static_cast<char*>(::operator new(_capacity));
+	}
+
+	_offset.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+** Linear allocator for data that lives for one frame.
+** Any thread may allocate; each allocation is one atomic add. Nothing is
+** freed on its own; reset releases everything at once, when the frame that
+** owns the arena is done.
+**
+** When a frame needs more than the arena holds, the rest comes from the
+** heap, and the next reset grows the arena to fit, so in steady state a
+** frame makes no heap allocations.
+*/
+class ga_frame_arena
+{
+public:
+	ga_frame_arena(size_t capacity = 64 * 1024);
+	~ga_frame_arena();
+
+	ga_frame_arena(const ga_frame_arena&) = delete;
+	ga_frame_arena& operator=(const ga_frame_arena&) = delete;
+
+	/* Returns storage aligned to k_alignment. */
+	void* allocate(size_t size);
+
+	/* Returns default-initialized storage for count objects; they're never destroyed. */
+	template<class T>
+	T* allocate_array(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "frame arena objects are never destroyed");
+		static_assert(alignof(T) <= k_alignment, "frame arena can't align this type");
+
+		T* array = static_cast<T*>(allocate(sizeof(T) * count));
+		for (size_t i = 0; i < count; ++i)
+		{
+			new (&array[i]) T;
+		}
+		return array;
+	}
+
+	/* Releases every allocation. Nothing may allocate concurrently. */
+	void reset();
+
+	size_t get_capacity() const { return _capacity; }
+
+	/* Most bytes used by any frame, including what spilled to the heap. */
+	size_t get_high_water() const { return _high_water; }
+
+	static const size_t k_alignment = alignof(std::max_align_t);
+
+private:
+	char* _base;
+	size_t _capacity;
+	std::atomic<size_t> _offset;
+	size_t _high_water;
+
+	std::mutex _overflow_lock;
+	std::vector<void*> _overflow;
+};
+
+/*
+** Standard allocator over a frame arena, for containers that only live for
+** a frame. Deallocation does nothing.
+*/
+template<class T>
+struct ga_frame_allocator
+{
+	typedef T value_type;
+
+	ga_frame_allocator(ga_frame_arena* arena) : _arena(arena) {}
+
+	template<class U>
+	ga_frame_allocator(const ga_frame_allocator<U>& other) : _arena(other._arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(_arena->allocate(sizeof(T) * count)); }
+	void deallocate(T* p, size_t count) {}
+
+	ga_frame_arena* _arena;
+};
+
+template<class T, class U>
+bool operator==(const ga_frame_allocator<T>& a, const ga_frame_allocator<U>& b) { return a._arena == b._arena; }
+
+template<class T, class U>
+bool operator!=(const ga_frame_allocator<T>& a, const ga_frame_allocator<U>& b) { return a._arena != b._arena; }
+
+template<class T>
+using ga_frame_vector = std::vector<T, ga_frame_allocator<T>>;
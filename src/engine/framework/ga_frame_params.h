@@ -10,11 +10,14 @@
 */
 
 #include "ga_drawcall.h"
+#include "ga_frame_arena.h"
+#include "jobs/ga_job.h"
 #include "math/ga_mat4f.h"
 
-#include <atomic>
+#include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 /*
@@ -55,6 +58,21 @@ enum ga_button_t
 	k_button_z		= 1 << 30,
 };
 
+/*
+** Drawcalls emitted by one worker during the sim stage.
+*/
+struct ga_drawcall_bucket
+{
+	std::vector<ga_draw_packet> _draw_packets;
+	std::vector<ga_mat4f> _transforms;
+
+	std::vector<ga_dynamic_drawcall> _dynamic_drawcalls;
+	std::vector<ga_dynamic_drawcall> _gui_drawcalls;
+
+	// Keeps neighboring workers' buckets off each other's cache lines.
+	char _padding[64];
+};
+
 /*
 ** Working information for the frame.
 ** Each frame stage emits some data for consumption by later stages.
@@ -72,18 +90,69 @@ struct ga_frame_params
 	float _mouse_x;
 	float _mouse_y;
 
-	// Data emitted by sim stage:
-	std::vector<ga_static_drawcall> _static_drawcalls;
-	std::atomic_flag _static_drawcall_lock = ATOMIC_FLAG_INIT;
-
-	std::vector<ga_dynamic_drawcall> _dynamic_drawcalls;
-	std::atomic_flag _dynamic_drawcall_lock = ATOMIC_FLAG_INIT;
+	// Storage for everything that lives until this frame is drawn, such as
+	// skinning matrices and dynamic geometry. Reset with the params.
+	ga_frame_arena _arena;
 
-	std::vector<ga_dynamic_drawcall> _gui_drawcalls;
-	std::atomic_flag _gui_drawcall_lock = ATOMIC_FLAG_INIT;
+	// Data emitted by sim stage. Components add drawcalls to their worker's
+	// bucket without locking, and output draws every bucket in turn. The
+	// last bucket is for threads outside the job system, one at a time.
+	std::vector<ga_drawcall_bucket> _drawcall_buckets;
 
+	// Emitted by the camera, before the late update.
 	ga_mat4f _view;
 
 	// Somewhat of a hack to make collision stable when stepping with a paused simulation.
 	bool _single_step = false;
+
+	// Create after the job system starts, to get a bucket per worker.
+	ga_frame_params() : _drawcall_buckets(ga_job::get_worker_count() + 1) {}
+
+	// Readies the params for another frame, keeping the drawcall lists' and
+	// the arena's storage.
+	void reset()
+	{
+		for (auto& bucket : _drawcall_buckets)
+		{
+			bucket._draw_packets.clear();
+			bucket._transforms.clear();
+			bucket._dynamic_drawcalls.clear();
+			bucket._gui_drawcalls.clear();
+		}
+		_arena.reset();
+		_single_step = false;
+	}
+
+	// Copies the transform into the bucket's transform array, makes room
+	// after it for skin_count skinning matrices, and sets the packet's indices
+	// into it and its sort key. Returns where the skin goes; fill it in before
+	// adding another drawcall. Uses _view for the key's depth, so call it from
+	// the late update.
+	ga_mat4f* add_draw_packet(ga_draw_packet packet, const ga_mat4f& transform, uint32_t skin_count = 0)
+	{
+		ga_drawcall_bucket& bucket = get_drawcall_bucket();
+
+		packet._transform = uint32_t(bucket._transforms.size());
+		packet._skin = packet._transform + 1;
+		packet._skin_count = skin_count;
+		bucket._transforms.resize(packet._skin + skin_count);
+		bucket._transforms[packet._transform] = transform;
+
+		float depth = -_view.transform_point(transform.get_translation()).z;
+		packet._sort_key = ga_draw_sort_key(packet._material, packet._vao, depth);
+
+		bucket._draw_packets.push_back(packet);
+		return bucket._transforms.data() + packet._skin;
+	}
+
+	void add_dynamic_drawcall(ga_dynamic_drawcall&& draw) { get_drawcall_bucket()._dynamic_drawcalls.push_back(std::move(draw)); }
+	void add_gui_drawcall(ga_dynamic_drawcall&& draw) { get_drawcall_bucket()._gui_drawcalls.push_back(std::move(draw)); }
+
+private:
+	ga_drawcall_bucket& get_drawcall_bucket()
+	{
+		int worker = ga_job::get_worker_index();
+		assert(worker < int(_drawcall_buckets.size()) - 1);
+		return _drawcall_buckets[worker >= 0 ? worker : _drawcall_buckets.size() - 1];
+	}
 };
@@ -0,0 +1,84 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_heap_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Constant initialized, so it's ready before any static constructor allocates.
+static std::atomic<uint64_t> _ga_heap_allocation_count(0);
+
+uint64_t ga_heap_counter::get_allocation_count()
+{
+	return _ga_heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+static void* _ga_heap_allocate(size_t size)
+{
+	_ga_heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+// Replacements for the global allocation functions.
+void* operator new(size_t size)
+{
+	void* p = _ga_heap_allocate(size);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return _ga_heap_allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return _ga_heap_allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
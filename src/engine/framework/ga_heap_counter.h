@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstdint>
+
+/*
+** Counts heap allocations made through the global operator new, to see how
+** many a frame makes. Memory the GL driver or SDL get from malloc directly
+** isn't counted.
+*/
+class ga_heap_counter
+{
+public:
+	static uint64_t get_allocation_count();
+};
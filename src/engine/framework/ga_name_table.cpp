@@ -0,0 +1,56 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_name_table.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Names by id, and ids by name. The deque never moves its strings, so
+// get_string can hand out pointers to them.
+struct ga_name_table_t
+{
+	std::mutex _lock;
+	std::deque<std::string> _names;
+	std::unordered_map<std::string, uint32_t> _ids;
+
+	ga_name_table_t() { _names.push_back(std::string()); _ids[std::string()] = 0; }
+};
+
+static ga_name_table_t& get_table()
+{
+	static ga_name_table_t table;
+	return table;
+}
+
+uint32_t ga_name_table::intern(const char* name)
+{
+	ga_name_table_t& table = get_table();
+	std::lock_guard<std::mutex> lock(table._lock);
+
+	auto it = table._ids.find(name);
+	if (it != table._ids.end())
+	{
+		return it->second;
+	}
+
+	uint32_t id = uint32_t(table._names.size());
+	table._names.push_back(name);
+	table._ids[name] = id;
+	return id;
+}
+
+const char* ga_name_table::get_string(uint32_t id)
+{
+	ga_name_table_t& table = get_table();
+	std::lock_guard<std::mutex> lock(table._lock);
+	return id < table._names.size() ? table._names[id].c_str() : "";
+}
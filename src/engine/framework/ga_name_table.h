@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstdint>
+
+/*
+** Interns names, so per-frame data can refer to them by a small id.
+** Ids last for the life of the program, and 0 is the empty name. Interning
+** takes a lock, so do it up front, not every frame.
+*/
+class ga_name_table
+{
+public:
+	static uint32_t intern(const char* name);
+	static const char* get_string(uint32_t id);
+};
@@ -10,9 +10,11 @@
 #include "ga_output.h"
 
 #include "ga_frame_params.h"
+#include "ga_radix_sort.h"
 
 #include "graphics/ga_material.h"
 #include "graphics/ga_program.h"
+#include "jobs/ga_profiler.h"
 #include "math/ga_mat4f.h"
 #include "math/ga_quatf.h"
 
@@ -45,6 +47,8 @@ ga_output::~ga_output()
 
 void ga_output::update(ga_frame_params* params)
 {
+	GA_PROFILE_SCOPE("ga_output::update");
+
 	// Update viewport in case window was resized:
 	int width, height;
 	SDL_GetWindowSize(static_cast<SDL_Window* >(_window), &width, &height);
@@ -66,17 +70,18 @@ void ga_output::update(ga_frame_params* params)
 	view.make_lookat_rh(ga_vec3f::z_vector(), -ga_vec3f::z_vector(), ga_vec3f::y_vector());
 	ga_mat4f view_ortho = view * ortho;
 
-	// Draw all static geometry:
-	for (auto& d : params->_static_drawcalls)
+	// Draw all static geometry, from every worker's bucket, in key order:
+	draw_packets(params, view_perspective);
+
+	// Draw all dynamic geometry, then the gui over it:
+	for (auto& bucket : params->_drawcall_buckets)
 	{
-		d._material->bind(view_perspective, d._transform);
-		glBindVertexArray(d._vao);
-		glDrawElements(d._draw_mode, d._index_count, GL_UNSIGNED_SHORT, 0);
+		draw_dynamic(bucket._dynamic_drawcalls, view_perspective);
+	}
+	for (auto& bucket : params->_drawcall_buckets)
+	{
+		draw_dynamic(bucket._gui_drawcalls, view_ortho);
 	}
-
-	// Draw all dynamic geometry:
-	draw_dynamic(params->_dynamic_drawcalls, view_perspective);
-	draw_dynamic(params->_gui_drawcalls, view_ortho);
 
 	GLenum error = glGetError();
 	assert(error == GL_NONE);
@@ -85,6 +90,44 @@ void ga_output::update(ga_frame_params* params)
 	SDL_GL_SwapWindow(static_cast<SDL_Window* >(_window));
 }
 
+void ga_output::draw_packets(const ga_frame_params* params, const ga_mat4f& view_proj)
+{
+	_sort_entries.clear();
+	for (uint32_t b = 0; b < params->_drawcall_buckets.size(); ++b)
+	{
+		const std::vector<ga_draw_packet>& packets = params->_drawcall_buckets[b]._draw_packets;
+		for (uint32_t p = 0; p < packets.size(); ++p)
+		{
+			_sort_entries.push_back({ packets[p]._sort_key, b, p });
+		}
+	}
+	_sort_scratch.resize(_sort_entries.size());
+
+	const sort_entry_t* sorted = ga_radix_sort(_sort_entries.data(), _sort_scratch.data(), _sort_entries.size(),
+		[](const sort_entry_t& e) { return e._key; });
+
+	GLuint bound_vao = 0;
+	for (size_t i = 0; i < _sort_entries.size(); ++i)
+	{
+		const ga_drawcall_bucket& bucket = params->_drawcall_buckets[sorted[i]._bucket];
+		const ga_draw_packet& d = bucket._draw_packets[sorted[i]._packet];
+
+		ga_material* material = ga_material::from_id(d._material);
+		if (d._skin_count)
+		{
+			material->set_skin(&bucket._transforms[d._skin], d._skin_count);
+		}
+		material->bind(view_proj, bucket._transforms[d._transform]);
+
+		if (d._vao != bound_vao)
+		{
+			glBindVertexArray(d._vao);
+			bound_vao = d._vao;
+		}
+		glDrawElements(d._draw_mode, d._index_count, GL_UNSIGNED_SHORT, 0);
+	}
+}
+
 void ga_output::draw_dynamic(const std::vector<ga_dynamic_drawcall>& drawcalls, const ga_mat4f& view_proj)
 {
 	for (auto& d : drawcalls)
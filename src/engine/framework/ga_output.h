@@ -27,9 +27,22 @@ public:
 	void update(struct ga_frame_params* params);
 
 private:
+	void draw_packets(const struct ga_frame_params* params, const ga_mat4f& view_proj);
 	void draw_dynamic(const std::vector<ga_dynamic_drawcall>& drawcalls, const ga_mat4f& view_proj);
 
 	void* _window;
 
 	class ga_constant_color_material* _default_material;
+
+	// A packet to draw, by bucket and index, with its key copied in to sort by.
+	struct sort_entry_t
+	{
+		uint64_t _key;
+		uint32_t _bucket;
+		uint32_t _packet;
+	};
+
+	// Kept between frames to reuse their storage.
+	std::vector<sort_entry_t> _sort_entries;
+	std::vector<sort_entry_t> _sort_scratch;
 };
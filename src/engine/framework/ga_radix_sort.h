@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+** Stable LSD radix sort of items by a 64-bit key, a byte per pass.
+** Items move between the two arrays on each pass, so returns whichever
+** holds the result. Passes over a byte that every key shares are skipped;
+** sort keys pack a few fields and most bytes rarely vary.
+**
+** get_key maps an item to its key; items should be cheap to copy.
+*/
+template<class T, class K>
+T* ga_radix_sort(T* items, T* scratch, size_t count, K get_key)
+{
+	const int k_passes = 8;
+	const int k_radix = 256;
+
+	uint32_t histograms[k_passes][k_radix];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = get_key(items[i]);
+		for (int pass = 0; pass < k_passes; ++pass)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xff]++;
+		}
+	}
+
+	T* source = items;
+	T* dest = scratch;
+	for (int pass = 0; pass < k_passes; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		if (count == 0 || histogram[(get_key(source[0]) >> (pass * 8)) & 0xff] == count)
+		{
+			continue;
+		}
+
+		// Histogram to starting offsets.
+		uint32_t offset = 0;
+		for (int digit = 0; digit < k_radix; ++digit)
+		{
+			uint32_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t digit = (get_key(source[i]) >> (pass * 8)) & 0xff;
+			dest[histogram[digit]++] = source[i];
+		}
+
+		T* temp = source;
+		source = dest;
+		dest = temp;
+	}
+
+	return source;
+}
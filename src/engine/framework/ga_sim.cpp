@@ -9,88 +9,581 @@
 
 #include "ga_sim.h"
 
-#include "ga_compiler_defines.h"
-
+#include "entity/ga_component.h"
 #include "entity/ga_entity.h"
+#include "framework/ga_radix_sort.h"
 #include "jobs/ga_job.h"
+#include "jobs/ga_profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <typeinfo>
+
+// Number of consecutive entities updated by a single batch of a job.
+static const int k_entity_batch_size = 32;
 
-#if defined(GA_MINGW)
-#include <malloc.h>
-#endif
+// Number of consecutive components of one type updated by a single batch.
+static const int k_component_batch_size = 64;
 
-ga_sim::ga_sim()
+// Schedule unit of a component that isn't in the schedule.
+static const uint32_t k_unscheduled = 0xffffffff;
+
+ga_sim::ga_sim() : _command_buffers(ga_job::get_worker_count() + 1)
 {
+	// Workers record into buffers by index, so there must be one for each.
+	if (ga_job::get_worker_count() == 0)
+	{
+		printf("ga_sim: created before ga_job::startup; start the job system first.\n");
+		fflush(stdout);
+		abort();
+	}
+
+	for (size_t i = 0; i < _command_buffers.size(); ++i)
+	{
+		_command_buffers[i]._buffer_index = uint32_t(i);
+	}
 }
 
 ga_sim::~ga_sim()
 {
+	// Entities the caller owns may already be gone; leave them be.
+	for (uint32_t index : _entity_records)
+	{
+		if (_records[index]._owned)
+		{
+			for (ga_component* c : _records[index]._entity->get_components())
+			{
+				delete c;
+			}
+		}
+	}
+	for (ga_entity* block : _entity_blocks)
+	{
+		delete[] block;
+	}
+}
+
+ga_entity_handle ga_sim::create_entity()
+{
+	uint32_t index = allocate_record();
+	if (index / k_entities_per_block == _entity_blocks.size())
+	{
+		_entity_blocks.push_back(new ga_entity[k_entities_per_block]);
+	}
+	ga_entity* ent = &_entity_blocks[index / k_entities_per_block][index % k_entities_per_block];
+	return add_record(ent, index, true);
+}
+
+ga_entity_handle ga_sim::add_entity(ga_entity* ent)
+{
+	return add_record(ent, allocate_record(), false);
+}
+
+uint32_t ga_sim::allocate_record()
+{
+	if (!_free_records.empty())
+	{
+		uint32_t index = _free_records.back();
+		_free_records.pop_back();
+		return index;
+	}
+	_records.push_back({ nullptr, 0, 0, false });
+	return uint32_t(_records.size()) - 1;
 }
 
-void ga_sim::add_entity(ga_entity* ent)
+ga_entity_handle ga_sim::add_record(ga_entity* ent, uint32_t index, bool owned)
 {
+	entity_record_t& record = _records[index];
+	record._entity = ent;
+	record._list_index = uint32_t(_entities.size());
+	record._owned = owned;
+
 	_entities.push_back(ent);
+	_entity_records.push_back(index);
+	_component_groups_dirty = true;
+
+	ent->_sim = this;
+	ent->_handle = { index, record._generation };
+	for (ga_component* c : ent->get_components())
+	{
+		schedule_component(ent, c);
+	}
+	return ent->_handle;
 }
 
-void ga_sim::update(ga_frame_params* params)
+void ga_sim::destroy_entity(ga_entity_handle handle)
 {
-	// Create jobs that update all entities in parallel (one job per entity).
-	// There are 2 components:
-	// 1. The job declarations; a function and a pointer to data for that function.
-	// 2. The data for each job; an entity and the frame_params.
+	std::lock_guard<std::mutex> lock(_destroy_lock);
+	_destroy_queue.push_back(handle);
+}
 
-	auto decls = static_cast<ga_job_decl_t*>(alloca(sizeof(ga_job_decl_t) * _entities.size()));
+ga_entity* ga_sim::get_entity(ga_entity_handle handle)
+{
+	const entity_record_t* record = find(handle);
+	return record ? record->_entity : nullptr;
+}
 
-	struct update_data_t
+bool ga_sim::is_alive(ga_entity_handle handle) const
+{
+	return find(handle) != nullptr;
+}
+
+const ga_sim::entity_record_t* ga_sim::find(ga_entity_handle handle) const
+{
+	if (handle._index >= _records.size() || _records[handle._index]._generation != handle._generation || !_records[handle._index]._entity)
 	{
-		ga_entity* _entity;
-		ga_frame_params* _params;
-	};
-	auto update_data = static_cast<update_data_t*>(alloca(sizeof(update_data_t) * _entities.size()));
+		return nullptr;
+	}
+	return &_records[handle._index];
+}
+
+void ga_sim::remove_destroyed_entities()
+{
+	{
+		std::lock_guard<std::mutex> lock(_destroy_lock);
+		_destroying.swap(_destroy_queue);
+	}
 
-	for (int i = 0; i < _entities.size(); ++i)
+	// A handle queued twice is stale the second time.
+	for (ga_entity_handle handle : _destroying)
 	{
-		update_data[i]._entity = _entities[i];
-		update_data[i]._params = params;
+		if (find(handle))
+		{
+			remove_entity(handle._index);
+		}
+	}
+	_destroying.clear();
+}
+
+void ga_sim::remove_entity(uint32_t index)
+{
+	entity_record_t& record = _records[index];
+
+	// Fill the entity's place in the update order with the last entity.
+	uint32_t last = uint32_t(_entities.size()) - 1;
+	if (record._list_index != last)
+	{
+		_entities[record._list_index] = _entities[last];
+		_entity_records[record._list_index] = _entity_records[last];
+		_records[_entity_records[last]]._list_index = record._list_index;
+	}
+	_entities.pop_back();
+	_entity_records.pop_back();
 
-		decls[i]._data = update_data + i;
-		decls[i]._entry = [](void* data)
+	for (ga_component* c : record._entity->get_components())
+	{
+		unschedule_component(c);
+	}
+	if (record._owned)
+	{
+		for (ga_component* c : record._entity->get_components())
 		{
-			auto update_data = static_cast<update_data_t*>(data);
-			update_data->_entity->update(update_data->_params);
-		};
+			delete c;
+		}
+		record._entity->reset();
 	}
 
-	// Dispatch the jobs:
-	int32_t update_counter;
-	ga_job::run(decls, int(_entities.size()), &update_counter);
-	ga_job::wait(&update_counter);
+	record._entity->_sim = nullptr;
+	record._entity->_handle = k_invalid_entity_handle;
+	record._entity = nullptr;
+	if (++record._generation == ga_entity_commands::k_spawned_generation)
+	{
+		record._generation = 0;
+	}
+	_free_records.push_back(index);
+	_component_groups_dirty = true;
 }
 
-void ga_sim::late_update(ga_frame_params* params)
+ga_entity_commands* ga_sim::get_commands()
+{
+	int worker = ga_job::get_worker_index();
+	assert(worker < int(_command_buffers.size()) - 1);
+	return &_command_buffers[worker >= 0 ? worker : _command_buffers.size() - 1];
+}
+
+void ga_sim::play_commands()
 {
-	auto decls = static_cast<ga_job_decl_t*>(alloca(sizeof(ga_job_decl_t) * _entities.size()));
+	GA_PROFILE_SCOPE("ga_sim::play_commands");
+
+	// Spawn first, so every other command can find its entity.
+	size_t command_count = 0;
+	for (ga_entity_commands& buffer : _command_buffers)
+	{
+		for (const ga_entity_commands::command_t& command : buffer._commands)
+		{
+			if (command._type == ga_entity_commands::k_command_spawn)
+			{
+				buffer._spawned.push_back(create_entity());
+			}
+		}
+		command_count += buffer._commands.size();
+	}
+	if (command_count == 0)
+	{
+		return;
+	}
 
-	struct update_data_t
+	auto resolve = [this](ga_entity_handle handle)
 	{
-		ga_entity* _entity;
-		ga_frame_params* _params;
+		if (handle._generation != ga_entity_commands::k_spawned_generation)
+		{
+			return handle;
+		}
+		uint32_t buffer = handle._index >> ga_entity_commands::k_spawn_index_bits;
+		uint32_t spawn = handle._index & ga_entity_commands::k_spawn_index_mask;
+		if (buffer < _command_buffers.size() && spawn < _command_buffers[buffer]._spawned.size())
+		{
+			return _command_buffers[buffer]._spawned[spawn];
+		}
+		return k_invalid_entity_handle;
 	};
-	auto update_data = static_cast<update_data_t*>(alloca(sizeof(update_data_t) * _entities.size()));
 
-	for (int i = 0; i < _entities.size(); ++i)
+	// The rest by entity. The sort is stable, so an entity's commands from
+	// one buffer keep the order they were recorded in.
+	_command_entries.clear();
+	for (uint32_t b = 0; b < _command_buffers.size(); ++b)
+	{
+		const std::vector<ga_entity_commands::command_t>& commands = _command_buffers[b]._commands;
+		for (uint32_t c = 0; c < commands.size(); ++c)
+		{
+			if (commands[c]._type != ga_entity_commands::k_command_spawn)
+			{
+				_command_entries.push_back({ resolve(commands[c]._entity)._index, b, c });
+			}
+		}
+	}
+	_command_scratch.resize(_command_entries.size());
+	const command_entry_t* entries = ga_radix_sort(_command_entries.data(), _command_scratch.data(), _command_entries.size(), [](const command_entry_t& entry)
+	{
+		return uint64_t(entry._entity_index);
+	});
+
+	for (size_t i = 0; i < _command_entries.size(); ++i)
 	{
-		update_data[i]._entity = _entities[i];
-		update_data[i]._params = params;
+		ga_entity_commands::command_t& command = _command_buffers[entries[i]._buffer]._commands[entries[i]._command];
+		ga_entity_handle handle = resolve(command._entity);
+		const entity_record_t* record = find(handle);
 
-		decls[i]._data = update_data + i;
-		decls[i]._entry = [](void* data)
+		if (record && command._type == ga_entity_commands::k_command_reschedule)
+		{
+			// The component may have been removed since.
+			ga_component* c = static_cast<ga_component*>(command._payload);
+			const std::vector<ga_component*>& components = record->_entity->get_components();
+			if (std::find(components.begin(), components.end(), c) != components.end())
+			{
+				unschedule_component(c);
+				schedule_component(record->_entity, c);
+			}
+		}
+		else if (record && command._type == ga_entity_commands::k_command_despawn)
+		{
+			remove_entity(handle._index);
+		}
+		else if (!record || !record->_owned)
 		{
-			auto update_data = static_cast<update_data_t*>(data);
-			update_data->_entity->late_update(update_data->_params);
-		};
+			// Gone, or the caller's: its components aren't the sim's to change.
+			if (command._payload)
+			{
+				command._discard(command._payload);
+			}
+		}
+		else
+		{
+			command._play(record->_entity, command._payload);
+			_component_groups_dirty = true;
+		}
+		command._payload = nullptr;
+	}
+
+	for (ga_entity_commands& buffer : _command_buffers)
+	{
+		buffer.clear();
+	}
+}
+
+uint32_t ga_sim::get_interval_group(uint32_t interval)
+{
+	for (uint32_t g = 0; g < _interval_groups.size(); ++g)
+	{
+		if (_interval_groups[g]._interval == interval)
+		{
+			return g;
+		}
+	}
+
+	uint32_t group = uint32_t(_interval_groups.size());
+	_interval_groups.push_back({ interval, 0, std::vector<std::vector<uint32_t>>(interval), std::vector<std::chrono::high_resolution_clock::duration>(interval, _time) });
+
+	auto it = std::upper_bound(_group_order.begin(), _group_order.end(), interval, [this](uint32_t interval, uint32_t g)
+	{
+		return interval < _interval_groups[g]._interval;
+	});
+	_group_order.insert(it, group);
+	return group;
+}
+
+void ga_sim::schedule_component(ga_entity* ent, ga_component* comp)
+{
+	assert(comp->_schedule_unit == k_unscheduled);
+	if (comp->_asleep)
+	{
+		return;
+	}
+
+	// Join the entity's unit for this interval, if it has one.
+	uint32_t group = get_interval_group(comp->_update_interval);
+	uint32_t unit = k_unscheduled;
+	for (ga_component* c : ent->get_components())
+	{
+		if (c->_schedule_unit != k_unscheduled && _units[c->_schedule_unit]._group == group)
+		{
+			unit = c->_schedule_unit;
+			break;
+		}
+	}
+
+	if (unit == k_unscheduled)
+	{
+		if (!_free_units.empty())
+		{
+			unit = _free_units.back();
+			_free_units.pop_back();
+		}
+		else
+		{
+			unit = uint32_t(_units.size());
+			_units.emplace_back();
+		}
+
+		// Phases fill round robin, so each frame gets the same share.
+		interval_group_t& interval_group = _interval_groups[group];
+		uint32_t phase = interval_group._next_phase;
+		interval_group._next_phase = (phase + 1) % interval_group._interval;
+
+		schedule_unit_t& new_unit = _units[unit];
+		new_unit._entity = ent;
+		new_unit._group = group;
+		new_unit._phase = phase;
+		new_unit._list_index = uint32_t(interval_group._phases[phase].size());
+		interval_group._phases[phase].push_back(unit);
+	}
+
+	// Keep the unit in the order the entity lists its components.
+	std::vector<ga_component*>& components = _units[unit]._components;
+	size_t position = 0;
+	for (ga_component* c : ent->get_components())
+	{
+		if (c == comp)
+		{
+			break;
+		}
+		if (c->_schedule_unit == unit)
+		{
+			position++;
+		}
+	}
+	components.insert(components.begin() + position, comp);
+	comp->_schedule_unit = unit;
+}
+
+void ga_sim::unschedule_component(ga_component* comp)
+{
+	uint32_t unit = comp->_schedule_unit;
+	if (unit == k_unscheduled)
+	{
+		return;
+	}
+	comp->_schedule_unit = k_unscheduled;
+
+	schedule_unit_t& old_unit = _units[unit];
+	old_unit._components.erase(std::find(old_unit._components.begin(), old_unit._components.end(), comp));
+	if (!old_unit._components.empty())
+	{
+		return;
+	}
+
+	// Fill the unit's place in its list with the list's last unit.
+	std::vector<uint32_t>& list = _interval_groups[old_unit._group]._phases[old_unit._phase];
+	uint32_t moved = list.back();
+	list[old_unit._list_index] = moved;
+	_units[moved]._list_index = old_unit._list_index;
+	list.pop_back();
+
+	_free_units.push_back(unit);
+}
+
+void ga_sim::run_units(const std::vector<uint32_t>& list, ga_frame_params* params)
+{
+	const uint32_t* units = list.data();
+	const schedule_unit_t* all_units = _units.data();
+	ga_job::parallel_for(0, int(list.size()), k_entity_batch_size, [units, all_units, params](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			for (ga_component* c : all_units[units[i]]._components)
+			{
+				c->update(params);
+			}
+		}
+	},
+	k_job_priority_critical);
+}
+
+void ga_sim::update_schedule(ga_frame_params* params)
+{
+	// One interval at a time: an entity has a unit in each of several. Each
+	// sees the time since its list last ran, not just this frame's.
+	std::chrono::high_resolution_clock::duration frame_delta = params->_delta_time;
+	for (uint32_t g : _group_order)
+	{
+		interval_group_t& group = _interval_groups[g];
+		uint32_t phase = uint32_t(_frame % group._interval);
+		params->_delta_time = _time - group._last_run[phase];
+		group._last_run[phase] = _time;
+
+		run_units(group._phases[phase], params);
+	}
+	params->_delta_time = frame_delta;
+}
+
+void ga_sim::rebuild_component_groups()
+{
+	_component_groups.clear();
+	for (ga_entity* ent : _entities)
+	{
+		add_components(ent);
+	}
+	_component_groups_dirty = false;
+}
+
+void ga_sim::add_components(ga_entity* ent)
+{
+	// Groups run in the order types were first seen. Each of this entity's
+	// components must come from a later group than the one before it, or
+	// updating by type would change the order its components update in.
+	int previous_group = -1;
+	for (ga_component* c : ent->get_components())
+	{
+		std::type_index type(typeid(*c));
+
+		int group = 0;
+		while (group < int(_component_groups.size()) && _component_groups[group]._type != type)
+		{
+			++group;
+		}
+		if (group == int(_component_groups.size()))
+		{
+			_component_groups.push_back({ type, {} });
+		}
+		_component_groups[group]._components.push_back(c);
+
+		if (group <= previous_group && !_type_order_conflict)
+		{
+			printf("ga_sim: component order of an entity conflicts with earlier entities at %s; updating entity by entity.\n", type.name());
+			_type_order_conflict = true;
+		}
+		previous_group = group;
+	}
+}
+
+void ga_sim::update(ga_frame_params* params)
+{
+	GA_PROFILE_SCOPE("ga_sim::update");
+
+	// The frame boundary: no job is running on the entities.
+	remove_destroyed_entities();
+	play_commands();
+	_frame++;
+	_time += params->_delta_time;
+	if (_update_by_type && _component_groups_dirty)
+	{
+		rebuild_component_groups();
+	}
+
+	if (get_update_by_type())
+	{
+		// One type at a time, so a type sees the updates of the types before it.
+		for (auto& group : _component_groups)
+		{
+			ga_component** components = group._components.data();
+			ga_job::parallel_for(0, int(group._components.size()), k_component_batch_size, [components, params](int begin, int end)
+			{
+				for (int i = begin; i < end; ++i)
+				{
+					components[i]->update(params);
+				}
+			},
+			k_job_priority_critical);
+		}
+	}
+	else
+	{
+		// Update the units due this frame in parallel. The job system splits
+		// each list into contiguous batches and hands them to the workers.
+		update_schedule(params);
+	}
+
+	_store.parallel_for_each<ga_entity_adapter>(k_entity_batch_size, [params](ga_entity_id id, ga_entity_adapter& adapter)
+	{
+		adapter._entity->update(params);
+	},
+	k_job_priority_critical);
+
+	for (ga_sim_system_t system : _update_systems)
+	{
+		system(&_store, params);
+	}
+}
+
+void ga_sim::late_update(ga_frame_params* params)
+{
+	GA_PROFILE_SCOPE("ga_sim::late_update");
+
+	_transforms.update();
+
+	if (get_update_by_type())
+	{
+		for (auto& group : _component_groups)
+		{
+			ga_component** components = group._components.data();
+			ga_job::parallel_for(0, int(group._components.size()), k_component_batch_size, [components, params](int begin, int end)
+			{
+				for (int i = begin; i < end; ++i)
+				{
+					components[i]->late_update(params);
+				}
+			},
+			k_job_priority_critical);
+		}
+	}
+	else
+	{
+		// Every entity, every frame: late update emits drawcalls, so the
+		// schedule's intervals and sleep don't apply.
+		ga_entity** entities = _entities.data();
+		ga_job::parallel_for(0, int(_entities.size()), k_entity_batch_size, [entities, params](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				entities[i]->late_update(params);
+			}
+		},
+		k_job_priority_critical);
+	}
+
+	_store.parallel_for_each<ga_entity_adapter>(k_entity_batch_size, [params](ga_entity_id id, ga_entity_adapter& adapter)
+	{
+		adapter._entity->late_update(params);
+	},
+	k_job_priority_critical);
+
+	for (ga_sim_system_t system : _late_update_systems)
+	{
+		system(&_store, params);
 	}
 
-	int32_t update_counter;
-	ga_job::run(decls, int(_entities.size()), &update_counter);
-	ga_job::wait(&update_counter);
+	// Every job is done with the entities; make the frame's changes.
+	play_commands();
 }
@@ -9,23 +9,233 @@
 ** This file is distributed under the MIT License. See LICENSE.txt.
 */
 
+#include "entity/ga_entity.h"
+#include "entity/ga_entity_commands.h"
+#include "entity/ga_entity_store.h"
+#include "entity/ga_transform_hierarchy.h"
+
+#include <chrono>
+#include <mutex>
+#include <typeindex>
 #include <vector>
 
+
+/*
+** Update for components in the sim's entity store. Runs once per frame
+** stage and typically queries the store with parallel_for_each.
+*/
+typedef void (*ga_sim_system_t)(class ga_entity_store* store, struct ga_frame_params* params);
+
 /*
 ** Represents the simulation stage of the frame.
 ** Owns the entities.
+**
+** Entities live in slabs the sim allocates a block at a time, and are named
+** by handles whose generation changes when a slot is reused. Destroying an
+** entity only queues it; the start of the next update removes it, before
+** any job runs, so no job sees one half destroyed. Slots, and each
+** entity's component list, are reused, so in steady state creating and
+** destroying entities doesn't touch the heap. Components are pooled too.
+** @see ga_component
+**
+** Jobs can't create entities or change their components directly; they
+** record commands instead, which the sim plays back at the end of late
+** update. Commands are sorted by entity first, so each entity is visited
+** once and in slot order.
+** @see ga_entity_commands
+**
+** Components update from a schedule rather than entity by entity. Each
+** entity's awake components that share an update interval form a unit,
+** and units are spread over as many lists as their interval, one list run
+** per frame, so a crowd on an interval costs the same share every frame.
+** A list's update gets the delta time since the list last updated, all
+** of it, so a component that just joined one, or woke, may see up to its
+** interval's worth. Sleeping components are in no list and cost nothing.
+** Intervals run shortest first, each in parallel by unit, so an entity's
+** components still never run at once; within an interval they keep entity
+** order. Late update isn't scheduled: it runs entity by entity, every
+** component every frame, asleep or not, since it emits drawcalls.
+** Changes to the schedule wait for the frame boundary: the start of update
+** and the end of late update, where commands are played.
+** @see ga_sleep_bench
+**
+** Updates can run by component type: every component of one type, across
+** all entities, then every component of the next. Types run in the order
+** entities list them, so within an entity components still update in
+** order. If entities disagree on that order, or an entity has two
+** components of a type, the sim updates entity by entity instead.
+** Components are regrouped at the start of an update once entities have
+** come or gone, so add them before then.
+**
+** Updating by type ignores intervals and sleep.
+**
+** Updating by type only pays off when each type's components sit together
+** in memory, as they would in a pool per type; otherwise every pass pulls
+** in the other types' cache lines too. So it's off by default.
+** @see ga_component_update_bench
+**
+** The sim also owns an entity store, whose components sit in arrays by
+** type and are updated by systems. After the entities above, each stage
+** updates the ga_entity of every store entity with a ga_entity_adapter,
+** then runs the systems in the order they were added.
+** @see ga_entity_store_bench
+**
+** And a transform hierarchy. Update sets local transforms; late update
+** first brings the world matrices up to date, so everything in it may read
+** them.
+** @see ga_transform_bench
 */
 class ga_sim
 {
 public:
+	/* Aborts unless the job system is running; it sizes the command buffers. */
 	ga_sim();
 	~ga_sim();
 
-	void add_entity(class ga_entity* ent);
+	/*
+	** Creates an entity owned by the sim. Give it components with new; the
+	** sim deletes them with the entity. Not during an update.
+	*/
+	ga_entity_handle create_entity();
+
+	/*
+	** Adds an entity the caller owns, along with its components. Not during
+	** an update. The sim never touches it again once the sim is destroyed,
+	** so it may go first; but then its get_sim is stale, and its components
+	** mustn't change interval or sleep.
+	*/
+	ga_entity_handle add_entity(class ga_entity* ent);
+
+	/*
+	** Queues the entity for removal at the start of the next update. Until
+	** then it's still updated and its handle still finds it. Its components
+	** are deleted on the thread running the update. Thread safe.
+	*/
+	void destroy_entity(ga_entity_handle handle);
+
+	/* Null if the handle is stale. */
+	class ga_entity* get_entity(ga_entity_handle handle);
+	bool is_alive(ga_entity_handle handle) const;
+
+	uint32_t get_entity_count() const { return uint32_t(_entities.size()); }
+
+	/*
+	** The calling worker's command buffer. Outside the job system, one
+	** thread at a time may record, into a buffer of its own.
+	*/
+	ga_entity_commands* get_commands();
 
 	void update(struct ga_frame_params* params);
 	void late_update(struct ga_frame_params* params);
 
+	ga_entity_store* get_entity_store() { return &_store; }
+	ga_transform_hierarchy* get_transform_hierarchy() { return &_transforms; }
+
+	void add_update_system(ga_sim_system_t system) { _update_systems.push_back(system); }
+	void add_late_update_system(ga_sim_system_t system) { _late_update_systems.push_back(system); }
+
+	/* Turns updating by component type on or off. */
+	void set_update_by_type(bool enabled) { _update_by_type = enabled; }
+	bool get_update_by_type() const { return _update_by_type && !_type_order_conflict; }
+
 private:
+	friend class ga_entity;
+
+	struct entity_record_t
+	{
+		class ga_entity* _entity;
+		uint32_t _generation;
+		uint32_t _list_index;
+		bool _owned;
+	};
+
+	const entity_record_t* find(ga_entity_handle handle) const;
+	uint32_t allocate_record();
+	ga_entity_handle add_record(class ga_entity* ent, uint32_t index, bool owned);
+	void remove_entity(uint32_t index);
+	void remove_destroyed_entities();
+	void play_commands();
+
+	void add_components(class ga_entity* ent);
+	void rebuild_component_groups();
+
+	void schedule_component(class ga_entity* ent, class ga_component* comp);
+	void unschedule_component(class ga_component* comp);
+	uint32_t get_interval_group(uint32_t interval);
+	void run_units(const std::vector<uint32_t>& list, struct ga_frame_params* params);
+	void update_schedule(struct ga_frame_params* params);
+
+	// Every entity, and each one's record.
 	std::vector<class ga_entity*> _entities;
+	std::vector<uint32_t> _entity_records;
+
+	std::vector<entity_record_t> _records;
+	std::vector<uint32_t> _free_records;
+
+	// Owned entities, k_entities_per_block to a block; record i uses entity i.
+	std::vector<class ga_entity*> _entity_blocks;
+	static const uint32_t k_entities_per_block = 256;
+
+	std::mutex _destroy_lock;
+	std::vector<ga_entity_handle> _destroy_queue;
+	std::vector<ga_entity_handle> _destroying;
+
+	// A command buffer per worker, and one for other threads.
+	std::vector<ga_entity_commands> _command_buffers;
+
+	struct command_entry_t
+	{
+		uint32_t _entity_index;
+		uint32_t _buffer;
+		uint32_t _command;
+	};
+	std::vector<command_entry_t> _command_entries;
+	std::vector<command_entry_t> _command_scratch;
+
+	// Components of one type across all entities, in entity order.
+	struct component_group_t
+	{
+		std::type_index _type;
+		std::vector<class ga_component*> _components;
+	};
+	std::vector<component_group_t> _component_groups;
+
+	// An entity's awake components with the same interval, in entity order.
+	struct schedule_unit_t
+	{
+		class ga_entity* _entity;
+		uint32_t _group;
+		uint32_t _phase;
+		uint32_t _list_index;
+		std::vector<class ga_component*> _components;
+	};
+	std::vector<schedule_unit_t> _units;
+	std::vector<uint32_t> _free_units;
+
+	// Units on one interval, in a list per phase, and the sim time each list
+	// last updated; the next unit goes in the phase after the last one's.
+	struct interval_group_t
+	{
+		uint32_t _interval;
+		uint32_t _next_phase;
+		std::vector<std::vector<uint32_t>> _phases;
+		std::vector<std::chrono::high_resolution_clock::duration> _last_run;
+	};
+	std::vector<interval_group_t> _interval_groups;
+
+	// Group indices, shortest interval first.
+	std::vector<uint32_t> _group_order;
+	uint64_t _frame = 0;
+
+	// Sum of every update's delta time.
+	std::chrono::high_resolution_clock::duration _time = std::chrono::high_resolution_clock::duration::zero();
+
+	bool _update_by_type = false;
+	bool _type_order_conflict = false;
+	bool _component_groups_dirty = false;
+
+	ga_entity_store _store;
+	ga_transform_hierarchy _transforms;
+	std::vector<ga_sim_system_t> _update_systems;
+	std::vector<ga_sim_system_t> _late_update_systems;
 };
@@ -13,6 +13,7 @@
 #include "ga_debug_geometry.h"
 #include "ga_geometry.h"
 #include "entity/ga_entity.h"
+#include "jobs/ga_profiler.h"
 
 #include <cassert>
 
@@ -34,6 +35,8 @@ ga_animation_component::~ga_animation_component()
 
 void ga_animation_component::update(ga_frame_params* params)
 {
+	GA_PROFILE_SCOPE("ga_animation_component::update");
+
 	// TODO: Homework 6.
 	// If an animation is playing, update its local time and determine the current frame.
 	// Using the pose of the current frame, you must calculate each joint's new world
@@ -44,12 +47,10 @@ void ga_animation_component::update(ga_frame_params* params)
 	{
 		ga_joint* j = _skeleton->_joints[joint_index];
 
-		ga_dynamic_drawcall drawcall;
+		ga_dynamic_drawcall drawcall(&params->_arena);
 		draw_debug_sphere(0.4f, j->_world * get_entity()->get_transform(), &drawcall);
 
-		while (params->_dynamic_drawcall_lock.test_and_set(std::memory_order_acquire)) {}
-		params->_dynamic_drawcalls.push_back(drawcall);
-		params->_dynamic_drawcall_lock.clear(std::memory_order_release);
+		params->add_dynamic_drawcall(std::move(drawcall));
 	}
 #endif
 }
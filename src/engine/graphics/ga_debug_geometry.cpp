@@ -16,24 +16,32 @@
 #include "math/ga_quatf.h"
 #include "math/ga_vec4f.h"
 
-#include <vector>
-
 void draw_debug_sphere(float radius, const ga_mat4f& transform, ga_dynamic_drawcall* drawcall)
 {
 	// Represent the sphere with a circle around each axis.
-	std::vector<ga_vec3f> axes;
-	axes.push_back(ga_vec3f::x_vector());
-	axes.push_back(ga_vec3f::y_vector());
-	axes.push_back(ga_vec3f::z_vector());
+	const ga_vec3f axes[] =
+	{
+		ga_vec3f::x_vector(),
+		ga_vec3f::y_vector(),
+		ga_vec3f::z_vector(),
+	};
+	const uint32_t k_axis_count = sizeof(axes) / sizeof(axes[0]);
 
 	const uint32_t k_line_segments = 36;
 
-	std::vector<ga_vec4f> starts;
-	starts.push_back({ 0.0f, 0.0f, radius, 1.0f });
-	starts.push_back({ 0.0f, 0.0f, radius, 1.0f });
-	starts.push_back({ radius, 0.0f, 0.0f, 1.0f });
+	const ga_vec4f starts[] =
+	{
+		{ 0.0f, 0.0f, radius, 1.0f },
+		{ 0.0f, 0.0f, radius, 1.0f },
+		{ radius, 0.0f, 0.0f, 1.0f },
+	};
+
+	// The geometry comes from the frame arena, which never gets back what a
+	// growing vector leaves behind, so size it up front.
+	drawcall->_positions.reserve(drawcall->_positions.size() + k_axis_count * k_line_segments);
+	drawcall->_indices.reserve(drawcall->_indices.size() + k_axis_count * k_line_segments * 2);
 
-	for (uint32_t axis = 0; axis < axes.size(); ++axis)
+	for (uint32_t axis = 0; axis < k_axis_count; ++axis)
 	{
 		const float rotation_radians = ga_degrees_to_radians(360.0f / float(k_line_segments));
 		ga_quatf rotation_quat;
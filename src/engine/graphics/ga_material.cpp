@@ -11,10 +11,44 @@
 
 #include "ga_animation.h"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
+
+// Materials by id. Id 0 is never given out, so it can mean no material.
+static std::vector<ga_material*> _ga_materials(1, nullptr);
+static std::vector<uint32_t> _ga_free_material_ids;
+
+ga_material::ga_material()
+{
+	if (!_ga_free_material_ids.empty())
+	{
+		_id = _ga_free_material_ids.back();
+		_ga_free_material_ids.pop_back();
+	}
+	else
+	{
+		_id = uint32_t(_ga_materials.size());
+		_ga_materials.push_back(nullptr);
+	}
+	assert(_id < k_max_materials);
+	_ga_materials[_id] = this;
+}
+
+ga_material::~ga_material()
+{
+	_ga_materials[_id] = nullptr;
+	_ga_free_material_ids.push_back(_id);
+}
+
+ga_material* ga_material::from_id(uint32_t id)
+{
+	assert(id < _ga_materials.size() && _ga_materials[id]);
+	return _ga_materials[id];
+}
 
 void load_shader(const char* filename, std::string& contents)
 {
@@ -144,7 +178,7 @@ void ga_constant_color_material::bind(const ga_mat4f& view_proj, const ga_mat4f&
 	glDepthMask(GL_TRUE);
 }
 
-ga_animated_material::ga_animated_material(ga_skeleton* skeleton) : _skeleton(skeleton)
+ga_animated_material::ga_animated_material(ga_skeleton* skeleton) : _skeleton(skeleton), _skin(0), _skin_count(0)
 {
 }
 
@@ -192,12 +226,21 @@ void ga_animated_material::bind(const ga_mat4f& view_proj, const ga_mat4f& trans
 
 	mvp_uniform.set(transform * view_proj);
 	
-	// Collect the skinning matrices.
+	// Collect the skinning matrices, from the draw if it captured them.
 	ga_mat4f skin[ga_skeleton::k_max_skeleton_joints];
-	for (uint32_t i = 0; i < _skeleton->_joints.size(); ++i)
+	if (_skin)
+	{
+		assert(_skin_count <= ga_skeleton::k_max_skeleton_joints);
+		std::copy(_skin, _skin + _skin_count, skin);
+		_skin = 0;
+	}
+	else
 	{
-		assert(i < ga_skeleton::k_max_skeleton_joints);
-		skin[i] = _skeleton->_joints[i]->_skin;
+		for (uint32_t i = 0; i < _skeleton->_joints.size(); ++i)
+		{
+			assert(i < ga_skeleton::k_max_skeleton_joints);
+			skin[i] = _skeleton->_joints[i]->_skin;
+		}
 	}
 	skin_uniform.set(skin, ga_skeleton::k_max_skeleton_joints);
 
@@ -15,6 +15,7 @@
 #include "math/ga_mat4f.h"
 #include "math/ga_vec3f.h"
 
+#include <cstdint>
 #include <string>
 
 /*
@@ -24,11 +25,31 @@
 class ga_material
 {
 public:
+	ga_material();
+	virtual ~ga_material();
+
 	virtual bool init() = 0;
 
 	virtual void bind(const ga_mat4f& view_proj, const ga_mat4f& transform) = 0;
 
 	virtual void set_color(const ga_vec3f& color) {}
+
+	/* Skinning matrices for the next bind only. */
+	virtual void set_skin(const ga_mat4f* skin, uint32_t count) {}
+
+	/*
+	** Small id that draw packets refer to the material by; ids of destroyed
+	** materials are reused. Create and destroy materials on the main thread,
+	** which owns the GL context and draws.
+	*/
+	uint32_t get_id() const { return _id; }
+	static ga_material* from_id(uint32_t id);
+
+	/* Ids fit the material bits of a draw sort key. */
+	static const uint32_t k_max_materials = 1 << 16;
+
+private:
+	uint32_t _id;
 };
 
 /*
@@ -87,10 +108,15 @@ public:
 	virtual bool init() override;
 	virtual void bind(const ga_mat4f& view_proj, const ga_mat4f& transform) override;
 
+	virtual void set_skin(const ga_mat4f* skin, uint32_t count) override { _skin = skin; _skin_count = count; }
+
 private:
 	ga_shader* _vs;
 	ga_shader* _fs;
 	ga_program* _program;
 
 	struct ga_skeleton* _skeleton;
+
+	const ga_mat4f* _skin;
+	uint32_t _skin_count;
 };
@@ -14,13 +14,16 @@
 #include "ga_material.h"
 
 #include "entity/ga_entity.h"
+#include "framework/ga_name_table.h"
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
 ga_model_component::ga_model_component(ga_entity* ent, ga_model* model, ga_material* material) :
 	ga_component(ent),
-	_material(material)
+	_material(material),
+	_skeleton(model->_skeleton),
+	_name(ga_name_table::intern("ga_animated_model_component"))
 {
 	_material->init();
 
@@ -86,17 +89,20 @@ ga_model_component::~ga_model_component()
 	delete _material;
 }
 
-void ga_model_component::update(ga_frame_params* params)
+void ga_model_component::late_update(ga_frame_params* params)
 {
-	ga_static_drawcall draw;
-	draw._name = "ga_animated_model_component";
+	ga_draw_packet draw;
+	draw._name = _name;
+	draw._material = _material->get_id();
 	draw._vao = _vao;
 	draw._index_count = _index_count;
-	draw._transform = get_entity()->get_transform();
 	draw._draw_mode = GL_TRIANGLES;
-	draw._material = _material;
 
-	while (params->_static_drawcall_lock.test_and_set(std::memory_order_acquire)) {}
-	params->_static_drawcalls.push_back(draw);
-	params->_static_drawcall_lock.clear(std::memory_order_release);
+	// Animation has posed the skeleton during update; capture it for output.
+	uint32_t joint_count = _skeleton ? uint32_t(_skeleton->_joints.size()) : 0;
+	ga_mat4f* skin = params->add_draw_packet(draw, get_entity()->get_transform(), joint_count);
+	for (uint32_t i = 0; i < joint_count; ++i)
+	{
+		skin[i] = _skeleton->_joints[i]->_skin;
+	}
 }
@@ -22,10 +22,12 @@ public:
 	ga_model_component(class ga_entity* ent, struct ga_model* model, class ga_material* material);
 	virtual ~ga_model_component();
 
-	virtual void update(struct ga_frame_params* params) override;
+	virtual void late_update(struct ga_frame_params* params) override;
 
 private:
 	class ga_material* _material;
+	struct ga_skeleton* _skeleton;
+	uint32_t _name;
 	uint32_t _vao;
 	uint32_t _vbos[4];
 	uint32_t _index_count;
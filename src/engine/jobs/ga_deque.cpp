@@ -0,0 +1,135 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_deque.h"
+
+#include <atomic>
+#include <cstdint>
+
+static const int k_ga_deque_cache_line = 64;
+
+struct ga_deque_impl_t
+{
+	/* Top and bottom live on separate cache lines; thieves only write top. */
+	std::atomic<int64_t> _top;
+	char _top_pad[k_ga_deque_cache_line - sizeof(std::atomic<int64_t>)];
+
+	std::atomic<int64_t> _bottom;
+	char _bottom_pad[k_ga_deque_cache_line - sizeof(std::atomic<int64_t>)];
+
+	std::atomic<void*>* _buffer;
+	int64_t _mask;
+};
+
+ga_deque::ga_deque(int capacity)
+{
+	auto impl = new ga_deque_impl_t;
+
+	/* Round capacity up to a power of two so we can mask instead of divide. */
+	int64_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	impl->_top = 0;
+	impl->_bottom = 0;
+	impl->_buffer = new std::atomic<void*>[size];
+	impl->_mask = size - 1;
+
+	_impl = impl;
+}
+
+ga_deque::~ga_deque()
+{
+	ga_deque_impl_t* impl = static_cast<ga_deque_impl_t*>(_impl);
+	delete[] impl->_buffer;
+	delete impl;
+}
+
+bool ga_deque::push(void* data)
+{
+	ga_deque_impl_t* impl = static_cast<ga_deque_impl_t*>(_impl);
+
+	int64_t bottom = impl->_bottom.load(std::memory_order_relaxed);
+	int64_t top = impl->_top.load(std::memory_order_acquire);
+	if (bottom - top > impl->_mask)
+	{
+		return false;
+	}
+
+	impl->_buffer[bottom & impl->_mask].store(data, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	impl->_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool ga_deque::pop(void** data)
+{
+	ga_deque_impl_t* impl = static_cast<ga_deque_impl_t*>(_impl);
+
+	/* Reserve the bottom element before looking at top. */
+	int64_t bottom = impl->_bottom.load(std::memory_order_relaxed) - 1;
+	impl->_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = impl->_top.load(std::memory_order_relaxed);
+
+	/* Deque was empty. */
+	if (top > bottom)
+	{
+		impl->_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void* popped = impl->_buffer[bottom & impl->_mask].load(std::memory_order_relaxed);
+
+	/* Last element: race thieves for it. */
+	if (top == bottom)
+	{
+		bool won = impl->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		impl->_bottom.store(bottom + 1, std::memory_order_relaxed);
+		if (!won)
+		{
+			return false;
+		}
+	}
+
+	*data = popped;
+	return true;
+}
+
+bool ga_deque::steal(void** data)
+{
+	ga_deque_impl_t* impl = static_cast<ga_deque_impl_t*>(_impl);
+
+	int64_t top = impl->_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = impl->_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return false;
+	}
+
+	void* stolen = impl->_buffer[top & impl->_mask].load(std::memory_order_relaxed);
+	if (!impl->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	*data = stolen;
+	return true;
+}
+
+int ga_deque::get_count() const
+{
+	ga_deque_impl_t* impl = static_cast<ga_deque_impl_t*>(_impl);
+	int64_t count = impl->_bottom.load(std::memory_order_relaxed) - impl->_top.load(std::memory_order_relaxed);
+	return count > 0 ? int(count) : 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Bounded, lock-free work-stealing deque.
+** The owning thread pushes and pops at the bottom; any thread may steal from the top.
+** https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
+** https://fzn.fr/readings/ppopp13.pdf
+*/
+class ga_deque
+{
+public:
+	ga_deque(int capacity);
+	~ga_deque();
+
+	/* Owner only. Fails if the deque is full. */
+	bool push(void* data);
+	bool pop(void** data);
+
+	/* Any thread. */
+	bool steal(void** data);
+
+	int get_count() const;
+
+private:
+	void* _impl;
+};
@@ -0,0 +1,118 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_event_count.h"
+
+#include <climits>
+
+#if defined(GA_LINUX)
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#endif
+
+ga_event_count::ga_event_count() : _epoch(0), _waiters(0)
+{
+}
+
+ga_event_count::~ga_event_count()
+{
+}
+
+uint32_t ga_event_count::prepare_wait()
+{
+	/*
+	** Registering comes before the caller's last check of its condition,
+	** and notify changes the condition before looking for waiters, so one
+	** side always sees the other.
+	*/
+	_waiters.fetch_add(1);
+	return _epoch.load();
+}
+
+void ga_event_count::cancel_wait()
+{
+	_waiters.fetch_sub(1);
+}
+
+void ga_event_count::notify_all()
+{
+	notify(INT_MAX);
+}
+
+#if defined(GA_LINUX)
+
+void ga_event_count::wait(uint32_t key, int timeout_ms)
+{
+	/* The kernel returns at once if a notify already moved the epoch on. */
+	if (_epoch.load() == key)
+	{
+		timespec timeout;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_nsec = long(timeout_ms % 1000) * 1000000;
+
+		syscall(SYS_futex, &_epoch, FUTEX_WAIT_PRIVATE, key, timeout_ms >= 0 ? &timeout : 0, 0, 0);
+	}
+	_waiters.fetch_sub(1);
+}
+
+void ga_event_count::notify(int count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_waiters.load() == 0)
+	{
+		return;
+	}
+
+	_epoch.fetch_add(1);
+	syscall(SYS_futex, &_epoch, FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+}
+
+#else
+
+void ga_event_count::wait(uint32_t key, int timeout_ms)
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (timeout_ms >= 0)
+		{
+			_condvar.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, key]() { return _epoch.load() != key; });
+		}
+		else
+		{
+			_condvar.wait(lock, [this, key]() { return _epoch.load() != key; });
+		}
+	}
+	_waiters.fetch_sub(1);
+}
+
+void ga_event_count::notify(int count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_waiters.load() == 0)
+	{
+		return;
+	}
+
+	/* Bump the epoch under the lock, so a waiter can't miss it between its check and sleeping. */
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_epoch.fetch_add(1);
+	}
+	int waiters = _waiters.load();
+	for (int i = 0; i < count && i < waiters; ++i)
+	{
+		_condvar.notify_one();
+	}
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "framework/ga_compiler_defines.h"
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined(GA_LINUX)
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/*
+** Event count: lets threads sleep until some condition they poll for may
+** have changed, without a lock on the notify side.
+**
+** A waiter calls prepare_wait, checks its condition once more, then either
+** cancel_wait or wait with the returned key. A notifier makes its change,
+** then calls notify, which costs one atomic load when nobody is waiting and
+** otherwise wakes at most the number of threads asked for.
+**
+** Waiters park on a futex on Linux, and on a condition variable elsewhere.
+*/
+class ga_event_count
+{
+public:
+	ga_event_count();
+	~ga_event_count();
+
+	uint32_t prepare_wait();
+	void cancel_wait();
+
+	/* Sleeps until notified after prepare_wait, or for at most timeout_ms. */
+	void wait(uint32_t key, int timeout_ms = -1);
+
+	void notify(int count);
+	void notify_all();
+
+private:
+	std::atomic<uint32_t> _epoch;
+	std::atomic<int32_t> _waiters;
+
+#if !defined(GA_LINUX)
+	std::condition_variable _condvar;
+	std::mutex _mutex;
+#endif
+};
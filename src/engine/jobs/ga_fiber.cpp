@@ -9,24 +9,46 @@
 
 #include "ga_fiber.h"
 
+/* Whole pages, and room for more than the entry frames. */
+static size_t _ga_fiber_align_stack_size(size_t stack_size)
+{
+	const size_t k_stack_align = 4 * 1024;
+	const size_t k_min_stack_size = 8 * 1024;
+	stack_size = stack_size > k_min_stack_size ? stack_size : k_min_stack_size;
+	return (stack_size + k_stack_align - 1) & ~(k_stack_align - 1);
+}
+
+#if defined(GA_MSVC) || defined(GA_MINGW)
+
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #undef WIN32_LEAN_AND_MEAN
 
-ga_fiber::ga_fiber(function_t func, void* func_data, size_t stack_size)
+ga_fiber::ga_fiber(function_t func, void* func_data, size_t stack_size, bool track_stack_use)
 {
-	const size_t k_stack_align = 64 * 1024;
-	stack_size = stack_size > k_stack_align ? stack_size : k_stack_align;
-	stack_size = (stack_size + k_stack_align - 1) & ~(k_stack_align - 1);
+	stack_size = _ga_fiber_align_stack_size(stack_size);
 
-	_impl = CreateFiber(stack_size, (LPFIBER_START_ROUTINE)func, func_data);
+	/*
+	** Reserve exactly the size asked for, rather than the executable's
+	** default; Windows commits pages as the stack grows, behind its own
+	** guard page.
+	*/
+	_impl = CreateFiberEx(0, stack_size, 0, (LPFIBER_START_ROUTINE)func, func_data);
 }
 
 ga_fiber::~ga_fiber()
 {
 	if (_impl)
 	{
-		DeleteFiber(_impl);
+		/* Deleting the running fiber would exit the thread; turn it back into a thread instead. */
+		if (_impl == GetCurrentFiber())
+		{
+			ConvertFiberToThread();
+		}
+		else
+		{
+			DeleteFiber(_impl);
+		}
 	}
 }
 
@@ -56,3 +78,253 @@ void* ga_fiber::get_data()
 {
 	return GetFiberData();
 }
+
+size_t ga_fiber::get_stack_use() const
+{
+	return 0;
+}
+
+void ga_fiber::reset_stack_use()
+{
+}
+
+#elif defined(GA_LINUX)
+
+#include <cassert>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+** Linux fiber state.
+** Callee-saved registers are pushed onto the fiber's own stack when it is
+** switched out, so the only register we need to remember is the stack pointer.
+** Unlike swapcontext, no signal mask is saved, so a switch never enters the kernel.
+*/
+struct ga_fiber_context_t
+{
+	void* _stack_pointer;
+	void* _data;
+
+	void* _stack;
+	size_t _stack_size;
+	size_t _guard_size;
+	bool _track_stack_use;
+};
+
+/* Fills unused stack when tracking; the first word that differs marks the peak. */
+static const uint64_t k_ga_fiber_stack_paint = 0xcdcdcdcdcdcdcdcdull;
+
+static void _ga_fiber_paint_stack(void* begin, void* end)
+{
+	for (uint64_t* p = static_cast<uint64_t*>(begin); p < static_cast<uint64_t*>(end); ++p)
+	{
+		*p = k_ga_fiber_stack_paint;
+	}
+}
+
+/*
+** The fiber currently running on this thread.
+** Only read through calls into this file; never cache it across a switch,
+** since the calling fiber may resume on a different thread.
+*/
+static thread_local ga_fiber_context_t* _ga_fiber_current = 0;
+
+extern "C" void _ga_fiber_switch_context(void** from_stack_pointer, void* to_stack_pointer);
+extern "C" void _ga_fiber_entry();
+
+#if defined(__x86_64__)
+
+/*
+** System V x86-64 context switch.
+** Saves rbp, rbx, r12-r15, MXCSR and the x87 control word on the current stack,
+** stores the stack pointer in *from, then restores the same from the new stack.
+** New fibers begin in _ga_fiber_entry with the function in r12 and data in r13.
+*/
+asm(
+	".text\n"
+	".globl _ga_fiber_switch_context\n"
+	".hidden _ga_fiber_switch_context\n"
+	".type _ga_fiber_switch_context, @function\n"
+	".align 16\n"
+	"_ga_fiber_switch_context:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size _ga_fiber_switch_context, .-_ga_fiber_switch_context\n"
+
+	".globl _ga_fiber_entry\n"
+	".hidden _ga_fiber_entry\n"
+	".type _ga_fiber_entry, @function\n"
+	".align 16\n"
+	"_ga_fiber_entry:\n"
+	"	movq %r13, %rdi\n"
+	"	callq *%r12\n"
+	"	ud2\n"
+	".size _ga_fiber_entry, .-_ga_fiber_entry\n"
+);
+
+static void* _ga_fiber_init_stack(void* stack, size_t stack_size, ga_fiber::function_t func, void* func_data)
+{
+	/*
+	** Build the frame _ga_fiber_switch_context expects to pop. The return
+	** address slot is placed so the stack is 16-byte aligned when
+	** _ga_fiber_entry makes its call.
+	*/
+	uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stack_size) & ~uintptr_t(15);
+	uint64_t* sp = reinterpret_cast<uint64_t*>(top - 16);
+
+	*--sp = reinterpret_cast<uint64_t>(&_ga_fiber_entry);
+	*--sp = 0;                                          // rbp
+	*--sp = 0;                                          // rbx
+	*--sp = reinterpret_cast<uint64_t>(func);           // r12
+	*--sp = reinterpret_cast<uint64_t>(func_data);      // r13
+	*--sp = 0;                                          // r14
+	*--sp = 0;                                          // r15
+	*--sp = uint64_t(0x1f80) | (uint64_t(0x037f) << 32); // MXCSR, x87 control word
+
+	return sp;
+}
+
+#else
+#error "ga_fiber: no context switch implementation for this architecture."
+#endif
+
+ga_fiber::ga_fiber(function_t func, void* func_data, size_t stack_size, bool track_stack_use)
+{
+	stack_size = _ga_fiber_align_stack_size(stack_size);
+
+	/* The stack grows down, so the guard page goes below it. */
+	size_t guard_size = size_t(sysconf(_SC_PAGESIZE));
+	char* mapping = static_cast<char*>(mmap(0, guard_size + stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0));
+	assert(mapping != MAP_FAILED);
+	int result = mprotect(mapping, guard_size, PROT_NONE);
+	assert(result == 0);
+	(void)result;
+
+	void* stack = mapping + guard_size;
+	if (track_stack_use)
+	{
+		_ga_fiber_paint_stack(stack, mapping + guard_size + stack_size);
+	}
+
+	auto context = new ga_fiber_context_t;
+	context->_data = func_data;
+	context->_stack = stack;
+	context->_stack_size = stack_size;
+	context->_guard_size = guard_size;
+	context->_track_stack_use = track_stack_use;
+	context->_stack_pointer = _ga_fiber_init_stack(stack, stack_size, func, func_data);
+
+	_impl = context;
+}
+
+ga_fiber::~ga_fiber()
+{
+	if (_impl)
+	{
+		ga_fiber_context_t* context = static_cast<ga_fiber_context_t*>(_impl);
+		if (context->_stack)
+		{
+			munmap(static_cast<char*>(context->_stack) - context->_guard_size, context->_guard_size + context->_stack_size);
+		}
+		if (_ga_fiber_current == context)
+		{
+			_ga_fiber_current = 0;
+		}
+		delete context;
+	}
+}
+
+ga_fiber& ga_fiber::operator=(ga_fiber&& other)
+{
+	if (&other != this)
+	{
+		_impl = other._impl;
+		other._impl = 0;
+	}
+	return *this;
+}
+
+ga_fiber ga_fiber::convert_thread(void* data)
+{
+	auto context = new ga_fiber_context_t;
+	context->_stack_pointer = 0;
+	context->_data = data;
+	context->_stack = 0;
+	context->_stack_size = 0;
+	context->_guard_size = 0;
+	context->_track_stack_use = false;
+
+	_ga_fiber_current = context;
+
+	ga_fiber fiber;
+	fiber._impl = context;
+	return fiber;
+}
+
+void ga_fiber::switch_to(const ga_fiber& fiber)
+{
+	ga_fiber_context_t* from = _ga_fiber_current;
+	ga_fiber_context_t* to = static_cast<ga_fiber_context_t*>(fiber._impl);
+	assert(from != 0);
+
+	_ga_fiber_current = to;
+	_ga_fiber_switch_context(&from->_stack_pointer, to->_stack_pointer);
+}
+
+void* ga_fiber::get_data()
+{
+	return _ga_fiber_current ? _ga_fiber_current->_data : 0;
+}
+
+size_t ga_fiber::get_stack_use() const
+{
+	ga_fiber_context_t* context = static_cast<ga_fiber_context_t*>(_impl);
+	if (!context || !context->_track_stack_use)
+	{
+		return 0;
+	}
+
+	const uint64_t* begin = static_cast<const uint64_t*>(context->_stack);
+	const uint64_t* end = begin + context->_stack_size / sizeof(uint64_t);
+	const uint64_t* p = begin;
+	while (p < end && *p == k_ga_fiber_stack_paint)
+	{
+		++p;
+	}
+	return size_t(end - p) * sizeof(uint64_t);
+}
+
+void ga_fiber::reset_stack_use()
+{
+	ga_fiber_context_t* context = static_cast<ga_fiber_context_t*>(_impl);
+	if (!context || !context->_track_stack_use)
+	{
+		return;
+	}
+	assert(context != _ga_fiber_current);
+
+	/* Everything below the saved stack pointer is dead while the fiber is switched out. */
+	_ga_fiber_paint_stack(context->_stack, context->_stack_pointer);
+}
+
+#endif
@@ -11,13 +11,18 @@
 
 #include "framework/ga_compiler_defines.h"
 
-#if defined(GA_MINGW)
+#if defined(GA_MINGW) || defined(GA_LINUX)
 #include <sys/types.h>
 #endif
 
 /*
 ** A fiber object.
 ** This the execution context for a thread including the registers and stack.
+** Uses Win32 fibers on Windows and a hand-written register switch on Linux.
+**
+** Stacks end in a guard page, so an overflow faults instead of corrupting
+** the neighboring allocation. With stack use tracking, the stack is painted
+** with a pattern up front, and the deepest point reached can be read back.
 */
 class ga_fiber
 {
@@ -26,7 +31,7 @@ public:
 
 	ga_fiber() : _impl(0) {}
 	ga_fiber(ga_fiber&& other) : _impl(other._impl) { other._impl = 0; }
-	ga_fiber(function_t func, void* func_data, size_t stack_size);
+	ga_fiber(function_t func, void* func_data, size_t stack_size, bool track_stack_use = false);
 	~ga_fiber();
 
 	ga_fiber& operator=(ga_fiber&& other);
@@ -35,6 +40,15 @@ public:
 	static void switch_to(const ga_fiber& fiber);
 	static void* get_data();
 
+	/*
+	** Peak stack use in bytes since creation or the last reset, or 0 if not
+	** tracked. Tracking is only implemented on Linux.
+	*/
+	size_t get_stack_use() const;
+
+	/* Restarts tracking from the current depth; the fiber must be switched out. */
+	void reset_stack_use();
+
 private:
 	void* _impl;
 };
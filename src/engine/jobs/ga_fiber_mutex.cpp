@@ -0,0 +1,150 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_fiber_mutex.h"
+
+#include "ga_job.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define GA_FIBER_MUTEX_PAUSE() _mm_pause()
+#else
+#define GA_FIBER_MUTEX_PAUSE()
+#endif
+
+static const int k_ga_fiber_mutex_spin_count = 64;
+
+/*
+** Contention totals by name. Frame data mutexes live for a frame, so stats
+** are folded in here as each one is destroyed.
+*/
+struct ga_fiber_mutex_stats_t
+{
+	const char* _name;
+	uint64_t _lock_count;
+	uint64_t _contended_count;
+};
+
+static const int k_ga_fiber_mutex_max_stats = 64;
+
+static ga_fiber_mutex_stats_t _ga_fiber_mutex_stats[k_ga_fiber_mutex_max_stats];
+static int _ga_fiber_mutex_stats_count = 0;
+static std::mutex _ga_fiber_mutex_stats_lock;
+
+ga_fiber_mutex::ga_fiber_mutex(const char* name) :
+	_state(k_unlocked),
+	_name(name),
+	_lock_count(0),
+	_contended_count(0)
+{
+}
+
+ga_fiber_mutex::~ga_fiber_mutex()
+{
+	if (_lock_count == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_ga_fiber_mutex_stats_lock);
+
+	ga_fiber_mutex_stats_t* stats = 0;
+	for (int i = 0; i < _ga_fiber_mutex_stats_count; ++i)
+	{
+		if (strcmp(_ga_fiber_mutex_stats[i]._name, _name) == 0)
+		{
+			stats = &_ga_fiber_mutex_stats[i];
+			break;
+		}
+	}
+	if (!stats && _ga_fiber_mutex_stats_count < k_ga_fiber_mutex_max_stats)
+	{
+		stats = &_ga_fiber_mutex_stats[_ga_fiber_mutex_stats_count++];
+		stats->_name = _name;
+		stats->_lock_count = 0;
+		stats->_contended_count = 0;
+	}
+	if (stats)
+	{
+		stats->_lock_count += _lock_count;
+		stats->_contended_count += _contended_count;
+	}
+}
+
+void ga_fiber_mutex::lock()
+{
+	_lock_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (try_lock())
+	{
+		return;
+	}
+	_contended_count.fetch_add(1, std::memory_order_relaxed);
+
+	/* Most critical sections are a few instructions; give the holder a moment. */
+	for (int i = 0; i < k_ga_fiber_mutex_spin_count; ++i)
+	{
+		GA_FIBER_MUTEX_PAUSE();
+		if (_state.load(std::memory_order_relaxed) == k_unlocked && try_lock())
+		{
+			return;
+		}
+	}
+
+	/* In a job, sleep on the mutex; unlock hands it to us before we resume. */
+	if (ga_job::suspend_on_mutex(this))
+	{
+		return;
+	}
+
+	while (!try_lock())
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool ga_fiber_mutex::try_lock()
+{
+	uintptr_t expected = k_unlocked;
+	return _state.compare_exchange_strong(expected, k_locked, std::memory_order_acquire);
+}
+
+void ga_fiber_mutex::unlock()
+{
+	uintptr_t expected = k_locked;
+	if (!_state.compare_exchange_strong(expected, k_unlocked, std::memory_order_release))
+	{
+		ga_job::unlock_mutex_to_waiter(this);
+	}
+}
+
+void ga_fiber_mutex::report_contention()
+{
+	std::lock_guard<std::mutex> lock(_ga_fiber_mutex_stats_lock);
+	if (_ga_fiber_mutex_stats_count == 0)
+	{
+		return;
+	}
+
+	printf("ga_fiber_mutex: %-40s %12s %12s %8s\n", "name", "locks", "contended", "rate");
+	for (int i = 0; i < _ga_fiber_mutex_stats_count; ++i)
+	{
+		const ga_fiber_mutex_stats_t& stats = _ga_fiber_mutex_stats[i];
+		printf("ga_fiber_mutex: %-40s %12llu %12llu %7.2f%%\n",
+			stats._name,
+			(unsigned long long)stats._lock_count,
+			(unsigned long long)stats._contended_count,
+			stats._lock_count ? 100.0 * stats._contended_count / stats._lock_count : 0.0);
+	}
+}
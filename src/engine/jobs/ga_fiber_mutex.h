@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <atomic>
+#include <cstdint>
+
+/*
+** Mutex for data shared between jobs.
+** A contended lock spins briefly, then a job suspends its fiber and its
+** worker goes on to other work. Unlock hands the mutex straight to a
+** suspended waiter and makes it runnable again. Outside a job, lock spins
+** and then yields the thread.
+**
+** The mutex isn't tied to a thread, so a job may hold it across a wait.
+** Works with std::lock_guard.
+*/
+class ga_fiber_mutex
+{
+public:
+	/* The name groups contention stats; it must outlive the program's report. */
+	ga_fiber_mutex(const char* name = "unnamed");
+	~ga_fiber_mutex();
+
+	ga_fiber_mutex(const ga_fiber_mutex&) = delete;
+	ga_fiber_mutex& operator=(const ga_fiber_mutex&) = delete;
+
+	void lock();
+	bool try_lock();
+	void unlock();
+
+	uint64_t get_lock_count() const { return _lock_count; }
+	uint64_t get_contended_count() const { return _contended_count; }
+
+	/* Prints lock and contention counts per name, summed over every mutex destroyed so far. */
+	static void report_contention();
+
+	/* State is 0 when free, 1 when held, otherwise held with this stack of waiting jobs. */
+	static const uintptr_t k_unlocked = 0;
+	static const uintptr_t k_locked = 1;
+
+private:
+	friend class ga_job;
+
+	std::atomic<uintptr_t> _state;
+
+	const char* _name;
+	std::atomic<uint64_t> _lock_count;
+	std::atomic<uint64_t> _contended_count;
+};
@@ -11,6 +11,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <mutex>
 
 struct ga_intpool_nodecount_t
 {
@@ -25,8 +26,9 @@ union ga_intpool_pointer_t
 	uint64_t _entire;
 	ga_intpool_nodecount_t _part;
 
+	/* Copies load atomically, so retry loops always see the shared list anew. */
 	ga_intpool_pointer_t() {}
-	ga_intpool_pointer_t(const ga_intpool_pointer_t& other) : _entire(other._entire) {}
+	ga_intpool_pointer_t(const ga_intpool_pointer_t& other) : _entire(other._atomic.load()) {}
 };
 
 struct ga_intpool_node_t
@@ -34,32 +36,59 @@ struct ga_intpool_node_t
 	ga_intpool_pointer_t _next;
 };
 
+/*
+** Nodes live in equally sized, power of two segments. A segment is never
+** freed or moved once added, so an index stays valid for the pool's life.
+*/
 struct ga_intpool_impl_t
 {
-	int _index_count;
+	uint32_t _segment_shift;
+	uint32_t _segment_mask;
+	int _max_segment_count;
+
+	std::atomic_int _segment_count;
+	ga_intpool_node_t** _segments;
+	std::mutex _grow_mutex;
 
 	ga_intpool_pointer_t _free_list;
 
-	ga_intpool_node_t* _nodes;
+	std::atomic_int _used;
+	std::atomic_int _high_water;
 };
 
 static const uint32_t k_ga_intpool_invalid_index = 0xffffffff;
 
-ga_intpool::ga_intpool(int index_count)
+static bool _ga_intpool_grow(ga_intpool_impl_t* impl);
+
+static ga_intpool_node_t* _ga_intpool_get_node(ga_intpool_impl_t* impl, uint32_t index)
 {
-	auto impl = new ga_intpool_impl_t;
+	return impl->_segments[index >> impl->_segment_shift] + (index & impl->_segment_mask);
+}
 
-	impl->_index_count = index_count;
-	impl->_free_list._entire = 0;
-	impl->_nodes = new ga_intpool_node_t[index_count];
+ga_intpool::ga_intpool(int index_count, int max_index_count)
+{
+	auto impl = new ga_intpool_impl_t;
 
-	for (int i = 0; i < index_count - 1; ++i)
+	uint32_t shift = 0;
+	while ((1u << shift) < uint32_t(index_count))
 	{
-		impl->_nodes[i]._next._part._index = i + 1;
-		impl->_nodes[i]._next._part._count = 0;
+		++shift;
 	}
-	impl->_nodes[index_count - 1]._next._part._index = k_ga_intpool_invalid_index;
-	impl->_nodes[index_count - 1]._next._part._count = 0;
+	uint32_t segment_size = 1u << shift;
+
+	max_index_count = max_index_count > index_count ? max_index_count : index_count;
+
+	impl->_segment_shift = shift;
+	impl->_segment_mask = segment_size - 1;
+	impl->_max_segment_count = int((uint32_t(max_index_count) + segment_size - 1) >> shift);
+	impl->_segment_count = 0;
+	impl->_segments = new ga_intpool_node_t*[impl->_max_segment_count];
+	impl->_free_list._part._index = k_ga_intpool_invalid_index;
+	impl->_free_list._part._count = 0;
+	impl->_used = 0;
+	impl->_high_water = 0;
+
+	_ga_intpool_grow(impl);
 
 	_impl = impl;
 }
@@ -67,7 +96,11 @@ ga_intpool::ga_intpool(int index_count)
 ga_intpool::~ga_intpool()
 {
 	ga_intpool_impl_t* impl = static_cast<ga_intpool_impl_t*>(_impl);
-	delete[] impl->_nodes;
+	for (int i = 0; i < impl->_segment_count; ++i)
+	{
+		delete[] impl->_segments[i];
+	}
+	delete[] impl->_segments;
 	delete impl;
 }
 
@@ -83,7 +116,7 @@ int ga_intpool::alloc()
 		if (free_list._part._index != k_ga_intpool_invalid_index)
 		{
 			index = free_list._part._index;
-			ga_intpool_pointer_t next = impl->_nodes[index]._next;
+			ga_intpool_pointer_t next = _ga_intpool_get_node(impl, index)->_next;
 
 			ga_intpool_pointer_t link;
 			link._part._index = next._part._index;
@@ -93,8 +126,16 @@ int ga_intpool::alloc()
 				break;
 			}
 		}
+		else if (!_ga_intpool_grow(impl))
+		{
+			return -1;
+		}
 	}
 
+	int used = ++impl->_used;
+	int high_water = impl->_high_water.load(std::memory_order_relaxed);
+	while (used > high_water && !impl->_high_water.compare_exchange_weak(high_water, used)) {}
+
 	return index;
 }
 
@@ -102,7 +143,9 @@ void ga_intpool::free(int index)
 {
 	ga_intpool_impl_t* impl = static_cast<ga_intpool_impl_t*>(_impl);
 
-	ga_intpool_node_t* node = impl->_nodes + index;
+	impl->_used--;
+
+	ga_intpool_node_t* node = _ga_intpool_get_node(impl, index);
 	for (;;)
 	{
 		ga_intpool_pointer_t free_list = impl->_free_list;
@@ -121,5 +164,69 @@ void ga_intpool::free(int index)
 int ga_intpool::get_index_count() const
 {
 	ga_intpool_impl_t* impl = static_cast<ga_intpool_impl_t*>(_impl);
-	return impl->_index_count;
+	return impl->_segment_count << impl->_segment_shift;
+}
+
+int ga_intpool::get_max_index_count() const
+{
+	ga_intpool_impl_t* impl = static_cast<ga_intpool_impl_t*>(_impl);
+	return impl->_max_segment_count << impl->_segment_shift;
+}
+
+int ga_intpool::get_high_water() const
+{
+	ga_intpool_impl_t* impl = static_cast<ga_intpool_impl_t*>(_impl);
+	return impl->_high_water;
+}
+
+/*
+** Adds a segment and pushes all of its indices onto the free list at once.
+** Returns true if the free list may have indices to hand out again.
+*/
+static bool _ga_intpool_grow(ga_intpool_impl_t* impl)
+{
+	std::lock_guard<std::mutex> lock(impl->_grow_mutex);
+
+	/* Someone else grew the pool, or indices were freed, while we waited. */
+	ga_intpool_pointer_t free_list = impl->_free_list;
+	if (free_list._part._index != k_ga_intpool_invalid_index)
+	{
+		return true;
+	}
+
+	int segment_index = impl->_segment_count;
+	if (segment_index >= impl->_max_segment_count)
+	{
+		return false;
+	}
+
+	uint32_t segment_size = impl->_segment_mask + 1;
+	uint32_t first = uint32_t(segment_index) << impl->_segment_shift;
+
+	ga_intpool_node_t* segment = new ga_intpool_node_t[segment_size];
+	for (uint32_t i = 0; i < segment_size - 1; ++i)
+	{
+		segment[i]._next._part._index = first + i + 1;
+		segment[i]._next._part._count = 0;
+	}
+	impl->_segments[segment_index] = segment;
+	impl->_segment_count = segment_index + 1;
+
+	ga_intpool_node_t* tail = segment + (segment_size - 1);
+	for (;;)
+	{
+		ga_intpool_pointer_t head = impl->_free_list;
+		tail->_next._part._index = head._part._index;
+		tail->_next._part._count = 0;
+
+		ga_intpool_pointer_t link;
+		link._part._index = first;
+		link._part._count = head._part._count + 1;
+		if (impl->_free_list._atomic.compare_exchange_strong(head._entire, link._entire))
+		{
+			break;
+		}
+	}
+
+	return true;
 }
@@ -11,17 +11,25 @@
 
 /*
 ** A thread-safe and lock-free pool of integers.
+** Starts with index_count indices and grows a segment at a time, up to
+** max_index_count, when it runs dry. Zero means it never grows.
 */
 class ga_intpool
 {
 public:
-	ga_intpool(int index_count);
+	ga_intpool(int index_count, int max_index_count = 0);
 	~ga_intpool();
 
+	/* Returns -1 if every index is in use and the pool can't grow. */
 	int alloc();
 	void free(int index);
 
+	/* Indices available now, and the most the pool will ever hand out. */
 	int get_index_count() const;
+	int get_max_index_count() const;
+
+	/* Most indices ever in use at once. */
+	int get_high_water() const;
 
 private:
 	void* _impl;
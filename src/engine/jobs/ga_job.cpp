@@ -9,60 +9,294 @@
 
 #include "ga_job.h"
 
-#include "ga_condvar.h"
+#include "ga_deque.h"
+#include "ga_event_count.h"
 #include "ga_fiber.h"
+#include "ga_fiber_mutex.h"
 #include "ga_intpool.h"
+#include "ga_profiler.h"
 #include "ga_queue.h"
+#include "ga_ring_queue.h"
 
+#include "framework/ga_compiler_defines.h"
+
+#include <algorithm>
 #include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define GA_JOB_PAUSE() _mm_pause()
+#else
+#define GA_JOB_PAUSE()
+#endif
+
 void* ga_job::_impl = 0;
 
+/*
+** Queue used for the global, ready and main thread queues.
+** Build with GA_JOB_RING_QUEUE=1 to use the bounded ring instead of the
+** linked queue.
+*/
+#if !defined(GA_JOB_RING_QUEUE)
+#define GA_JOB_RING_QUEUE 0
+#endif
+
+#if GA_JOB_RING_QUEUE
+typedef ga_ring_queue ga_job_queue_t;
+#else
+typedef ga_queue ga_job_queue_t;
+#endif
+
 struct ga_job_instance_t
 {
 	ga_job_instance_t() {}
 
-	ga_job_decl_t* _decl;
+	/* A copy, so the job's own decl may be freed or reused while it runs. */
+	ga_job_decl_t _decl;
 
-	int32_t* _waiting_count;
+	/* Set by a job that is suspending itself to wait on a counter or mutex state. */
+	ga_job_counter_t* _waiting_counter;
+	std::atomic<uintptr_t>* _waiting_mutex;
+	ga_job_instance_t* _next_waiter;
 
+	/* Index in the fiber pool of the job's stack class. */
 	int _pool_index;
 
+	/* What this run's stack use is reported under, when tracking it. */
+	uintptr_t _stack_use_key;
+
 	ga_fiber _fiber;
 	ga_fiber* _parent_fiber;
 };
 
+/*
+** Fibers of one stack class, and the job instances that own them.
+** Instances are indexed by pool index; they and their fibers are created
+** the first time an index is used.
+*/
+struct ga_job_fiber_pool_t
+{
+	ga_job_fiber_pool_t(int fiber_count, int max_fiber_count, size_t stack_size) :
+		_pool(fiber_count, max_fiber_count),
+		_stack_size(stack_size),
+		_stack_high_water(0),
+		_reported_exhausted(false)
+	{
+		_instances = new ga_job_instance_t*[_pool.get_max_index_count()];
+		for (int i = 0; i < _pool.get_max_index_count(); ++i)
+		{
+			_instances[i] = 0;
+		}
+	}
+
+	~ga_job_fiber_pool_t()
+	{
+		for (int i = 0; i < _pool.get_max_index_count(); ++i)
+		{
+			delete _instances[i];
+		}
+		delete[] _instances;
+	}
+
+	ga_intpool _pool;
+	ga_job_instance_t** _instances;
+	size_t _stack_size;
+
+	std::atomic<size_t> _stack_high_water;
+	std::atomic_bool _reported_exhausted;
+};
+
+/*
+** Peak stack use of one entry point in one stack class, when tracking.
+*/
+struct ga_job_stack_use_t
+{
+	size_t _peak;
+	uint32_t _run_count;
+};
+
+static const char* k_ga_job_stack_names[k_job_stack_count] = { "small", "default", "large" };
+
+static int _ga_job_sum_fiber_counts(const int* counts)
+{
+	int sum = 0;
+	for (int i = 0; i < k_job_stack_count; ++i)
+	{
+		sum += counts[i];
+	}
+	return sum;
+}
+
+/*
+** A lambda job submitted through the templated run.
+** The record frees itself once the callable returns; the scheduler works from
+** its own copy of the decl after that.
+*/
+struct ga_job_record_t
+{
+	ga_job_decl_t _decl;
+	void(*_invoke)(void* storage);
+
+	struct ga_job_system_impl_t* _system;
+	int _pool_index;
+
+	alignas(ga_job::k_record_capture_align) char _storage[ga_job::k_record_capture_size];
+};
+
+/*
+** Per-thread worker state.
+** Jobs run from inside a worker are pushed onto its own deque for their
+** priority; idle workers steal from the other end of their siblings' deques.
+** The main thread has a worker too, but only runs jobs while it waits.
+*/
+struct ga_job_worker_t
+{
+	ga_job_worker_t(struct ga_job_system_impl_t* system, int index, int deque_size, bool is_main) :
+		_system(system),
+		_index(index),
+		_is_main(is_main),
+		_cpu(-1),
+		_steal_seed(2654435761u * uint32_t(index + 1)),
+		_root_fiber(0),
+		_thread(0)
+	{
+		for (int i = 0; i < k_job_priority_count; ++i)
+		{
+			_deques[i] = new ga_deque(deque_size);
+		}
+	}
+
+	~ga_job_worker_t()
+	{
+		for (int i = 0; i < k_job_priority_count; ++i)
+		{
+			delete _deques[i];
+		}
+	}
+
+	struct ga_job_system_impl_t* _system;
+	int _index;
+	bool _is_main;
+
+	/* CPU the thread is pinned to, or -1. */
+	int _cpu;
+
+	ga_deque* _deques[k_job_priority_count];
+	uint32_t _steal_seed;
+
+	/* The thread's own fiber, which schedules jobs and which they return to. */
+	ga_fiber* _root_fiber;
+	std::thread* _thread;
+};
+
 struct ga_job_system_impl_t
 {
-	ga_job_system_impl_t(int queue_size, int fiber_count) :
-		_main_thread(std::this_thread::get_id()),
-		_job_queue(queue_size),
-		_job_instance_pool(fiber_count),
-		_wait_queue(queue_size)
-	{}
+	/*
+	** A job is only ever in one ready queue, and only while it holds a fiber,
+	** so the ready queues never need more room than the fiber pools together.
+	*/
+	ga_job_system_impl_t(const ga_job_config_t& config) :
+		_background_running(0),
+		_background_limit(1),
+		_job_record_pool(config._record_count, config._max_record_count),
+		_ready_queue(_ga_job_sum_fiber_counts(config._fiber_count), _ga_job_sum_fiber_counts(config._max_fiber_count)),
+		_main_queue(config._queue_size, config._max_queue_size),
+		_main_ready_queue(_ga_job_sum_fiber_counts(config._fiber_count), _ga_job_sum_fiber_counts(config._max_fiber_count)),
+		_fiber_starved(false),
+		_reported_records_exhausted(false),
+		_report_pool_usage(config._report_pool_usage),
+		_report_stack_usage(config._report_stack_usage)
+	{
+		for (int i = 0; i < k_job_priority_count; ++i)
+		{
+			_job_queues[i] = new ga_job_queue_t(config._queue_size, config._max_queue_size);
+		}
+		for (int i = 0; i < k_job_stack_count; ++i)
+		{
+			_fiber_pools[i] = new ga_job_fiber_pool_t(config._fiber_count[i], config._max_fiber_count[i], config._stack_size[i]);
+		}
+	}
+
+	~ga_job_system_impl_t()
+	{
+		for (int i = 0; i < k_job_priority_count; ++i)
+		{
+			delete _job_queues[i];
+		}
+		for (int i = 0; i < k_job_stack_count; ++i)
+		{
+			delete _fiber_pools[i];
+		}
+	}
+
+	/* Jobs submitted from outside the worker threads, or that overflowed a deque. */
+	ga_job_queue_t* _job_queues[k_job_priority_count];
+	std::vector<ga_job_worker_t*> _workers;
+
+	/* Background jobs started but not yet finished, and how many may be. */
+	std::atomic_int _background_running;
+	int _background_limit;
 
-	std::thread::id _main_thread;
+	/* One per stack class. */
+	ga_job_fiber_pool_t* _fiber_pools[k_job_stack_count];
 
-	ga_queue _job_queue;
+	/* Indexed by pool index; records are created the first time an index is used. */
+	ga_intpool _job_record_pool;
+	ga_job_record_t** _job_records;
 
-	ga_intpool _job_instance_pool;
-	ga_job_instance_t* _job_instance_data;
+	/* Suspended jobs whose counters have completed. */
+	ga_job_queue_t _ready_queue;
 
-	ga_queue _wait_queue;
+	/* Jobs pinned to the main thread, new and resumed. */
+	ga_fiber _main_fiber;
+	ga_job_queue_t _main_queue;
+	ga_job_queue_t _main_ready_queue;
 
-	std::vector<std::thread*> _worker_threads;
+	/* Idle workers park here; the main thread parks on its own while it waits. */
+	ga_event_count _work_added;
+	ga_event_count _main_wake;
 
-	ga_condvar _work_added;
-	ga_condvar _work_exhausted;
+	/* Set when a job was put back for want of a fiber, so finishing jobs wake a worker. */
+	std::atomic_bool _fiber_starved;
+
+	std::atomic_bool _reported_records_exhausted;
+	bool _report_pool_usage;
+
+	/* Peak stack use by entry point and stack class, when tracking. */
+	bool _report_stack_usage;
+	std::mutex _stack_use_lock;
+	std::map<std::pair<uintptr_t, int>, ga_job_stack_use_t> _stack_use;
 
 	bool _terminate;
 };
 
+static thread_local ga_job_worker_t* _ga_job_current_worker = 0;
+
+static ga_job_worker_t* _ga_job_get_worker();
+static void _ga_job_parallel_for_worker(void* data);
 static int _ga_job_instance_thread_worker(void* data);
-static bool _ga_job_schedule(ga_job_system_impl_t* impl, ga_fiber* parent_fiber);
+static bool _ga_job_schedule(ga_job_worker_t* worker, ga_fiber* parent_fiber);
+static bool _ga_job_find_work(ga_job_worker_t* worker, ga_job_decl_t** decl);
+static bool _ga_job_find_work_in_lane(ga_job_worker_t* worker, int priority, ga_job_decl_t** decl);
+static bool _ga_job_start(ga_job_worker_t* worker, ga_fiber* parent_fiber, ga_job_decl_t* decl);
+static ga_job_instance_t* _ga_job_get_instance(ga_job_system_impl_t* impl, ga_job_stack_t stack, int index);
+static uintptr_t _ga_job_get_stack_use_key(const ga_job_decl_t* decl);
+static void _ga_job_record_stack_use(ga_job_system_impl_t* impl, ga_job_instance_t* job);
+static void _ga_job_report_stack_use(ga_job_system_impl_t* impl);
+static ga_job_record_t* _ga_job_get_record(ga_job_system_impl_t* impl, int index);
+static void _ga_job_record_entry(void* data);
+static void _ga_job_resume(ga_job_system_impl_t* impl, ga_fiber* parent_fiber, ga_job_instance_t* job);
 static void _ga_job_run(ga_job_system_impl_t* impl, ga_fiber* parent_fiber, ga_job_instance_t* job);
+static void _ga_job_make_ready(ga_job_system_impl_t* impl, ga_job_instance_t* job);
+static bool _ga_job_add_waiter(ga_job_counter_t* counter, ga_job_instance_t* job);
+static bool _ga_job_add_mutex_waiter(std::atomic<uintptr_t>* mutex_state, ga_job_instance_t* job);
+static void _ga_job_complete(ga_job_system_impl_t* impl, ga_job_counter_t* counter);
 static void _ga_job_fiber_worker(void* data);
 
 void ga_job::startup(
@@ -70,24 +304,85 @@ void ga_job::startup(
 	int queue_size,
 	int fiber_count)
 {
-	ga_job_system_impl_t* impl = new ga_job_system_impl_t(queue_size, fiber_count);
+	ga_job_config_t config;
+	config._cpus = ga_cpu_set::from_mask(hardware_thread_mask);
+	config._use_smt_siblings = true;
+	config._pin_threads = false;
+	config._report_layout = false;
+	config._report_pool_usage = false;
+	config._queue_size = queue_size;
+	config._fiber_count[k_job_stack_default] = fiber_count;
+	startup(config);
+}
+
+void ga_job::startup(const ga_job_config_t& config)
+{
+	const int queue_size = config._queue_size;
+
+	ga_job_system_impl_t* impl = new ga_job_system_impl_t(config);
 
 	impl->_terminate = false;
 
-	impl->_job_instance_data = new ga_job_instance_t[fiber_count];
-	for (int i = 0; i < fiber_count; ++i)
+	/* Create the initial fibers up front; later ones as the pools grow. */
+	for (int stack = 0; stack < k_job_stack_count; ++stack)
 	{
-		ga_job_instance_t* instance = &impl->_job_instance_data[i];
-		instance->_fiber = ga_fiber(_ga_job_fiber_worker, instance, 64 * 1024);
-		instance->_pool_index = i;
+		for (int i = 0; i < impl->_fiber_pools[stack]->_pool.get_index_count(); ++i)
+		{
+			_ga_job_get_instance(impl, ga_job_stack_t(stack), i);
+		}
 	}
 
-	int hardware_thread_count = std::thread::hardware_concurrency();
-	for (int i = 0; i < hardware_thread_count; ++i)
+	int max_record_count = impl->_job_record_pool.get_max_index_count();
+	impl->_job_records = new ga_job_record_t*[max_record_count];
+	for (int i = 0; i < max_record_count; ++i)
+	{
+		impl->_job_records[i] = 0;
+	}
+	for (int i = 0; i < impl->_job_record_pool.get_index_count(); ++i)
 	{
-		if ((hardware_thread_mask & (1 << i)) != 0)
+		_ga_job_get_record(impl, i);
+	}
+
+	ga_cpu_topology topology;
+	std::vector<ga_cpu_t> cpus = topology.select(config._cpus, config._use_smt_siblings);
+	for (auto& cpu : cpus)
+	{
+		ga_job_worker_t* worker = new ga_job_worker_t(impl, int(impl->_workers.size()), queue_size, false);
+		worker->_cpu = config._pin_threads ? cpu._cpu : -1;
+		impl->_workers.push_back(worker);
+	}
+
+	if (config._report_layout)
+	{
+		printf("ga_job: %d worker%s on %d core%s, %d package%s, %s.\n",
+			int(cpus.size()), cpus.size() == 1 ? "" : "s",
+			topology.get_core_count(), topology.get_core_count() == 1 ? "" : "s",
+			topology.get_package_count(), topology.get_package_count() == 1 ? "" : "s",
+			config._pin_threads ? "pinned" : "unpinned");
+		for (size_t i = 0; i < cpus.size(); ++i)
+		{
+			printf("  worker %d: cpu %d (core %d, package %d, smt %d)\n",
+				int(i), cpus[i]._cpu, cpus[i]._core, cpus[i]._package, cpus[i]._smt_index);
+		}
+	}
+
+	/* Leave at least one worker free of background work when we can. */
+	impl->_background_limit = int(impl->_workers.size()) > 1 ? int(impl->_workers.size()) - 1 : 1;
+
+	/* Make the main thread a fiber, so it can run jobs while it waits. */
+	ga_job_worker_t* main_worker = new ga_job_worker_t(impl, int(impl->_workers.size()), queue_size, true);
+	impl->_main_fiber = ga_fiber::convert_thread(0);
+	main_worker->_root_fiber = &impl->_main_fiber;
+	impl->_workers.push_back(main_worker);
+	_ga_job_current_worker = main_worker;
+	GA_PROFILE_THREAD_NAME("main");
+
+	/* Start threads only once every deque exists, so thieves can see them all. */
+	for (auto& w : impl->_workers)
+	{
+		if (!w->_is_main)
 		{
-			impl->_worker_threads.push_back(new std::thread(_ga_job_instance_thread_worker, impl));
+			w->_thread = new std::thread(_ga_job_instance_thread_worker, w);
 		}
 	}
 
@@ -99,135 +394,820 @@ void ga_job::shutdown()
 	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
 
 	impl->_terminate = true;
-	impl->_work_added.wake_all();
-	for (auto& t : impl->_worker_threads)
+	impl->_work_added.notify_all();
+	for (auto& w : impl->_workers)
+	{
+		if (w->_thread)
+		{
+			w->_thread->join();
+			delete w->_thread;
+		}
+		delete w;
+	}
+	_ga_job_current_worker = 0;
+
+	if (impl->_report_pool_usage)
+	{
+		ga_job_stats_t stats;
+		get_stats(&stats);
+		printf("ga_job: fibers small %d/%d (limit %d), default %d/%d (limit %d), large %d/%d (limit %d) used; records %d/%d used (limit %d); queues critical %d, normal %d, background %d, main %d, ready %d entries (limit %d).\n",
+			stats._fiber_high_water[k_job_stack_small], stats._fiber_count[k_job_stack_small], stats._max_fiber_count[k_job_stack_small],
+			stats._fiber_high_water[k_job_stack_default], stats._fiber_count[k_job_stack_default], stats._max_fiber_count[k_job_stack_default],
+			stats._fiber_high_water[k_job_stack_large], stats._fiber_count[k_job_stack_large], stats._max_fiber_count[k_job_stack_large],
+			stats._record_high_water, stats._record_count, stats._max_record_count,
+			stats._queue_high_water[k_job_priority_critical],
+			stats._queue_high_water[k_job_priority_normal],
+			stats._queue_high_water[k_job_priority_background],
+			stats._main_queue_high_water,
+			stats._ready_high_water,
+			stats._max_queue_size);
+	}
+
+	if (impl->_report_stack_usage)
 	{
-		t->join();
-		delete t;
+		_ga_job_report_stack_use(impl);
 	}
 
-	delete[] impl->_job_instance_data;
+	int max_record_count = impl->_job_record_pool.get_max_index_count();
+	for (int i = 0; i < max_record_count; ++i)
+	{
+		delete impl->_job_records[i];
+	}
+	delete[] impl->_job_records;
+	delete impl;
+	_impl = 0;
 }
 
-void ga_job::run(ga_job_decl_t* decls, int decl_count, int32_t* counter)
+void ga_job::run(ga_job_decl_t* decls, int decl_count, ga_job_counter_t* counter)
 {
-	*counter = decl_count;
+	// No job would complete a reopened counter, so leave it as it is.
+	if (decl_count == 0)
+	{
+		return;
+	}
+
+	/*
+	** Add to a pending counter, or reopen a complete one's wait list. A count
+	** of zero may still be closing its list, so whoever reopens takes it to
+	** k_reopening while the job that took it to zero finishes closing, and
+	** everyone else waits for the count to be published again.
+	*/
+	int32_t value = counter->_value.load();
+	for (;;)
+	{
+		if (value == ga_job_counter_t::k_reopening)
+		{
+			std::this_thread::yield();
+			value = counter->_value.load();
+		}
+		else if (value > 0)
+		{
+			if (counter->_value.compare_exchange_weak(value, value + decl_count))
+			{
+				break;
+			}
+		}
+		else if (counter->_value.compare_exchange_weak(value, ga_job_counter_t::k_reopening))
+		{
+			while (counter->_waiters.load() != ga_job_counter_t::k_complete)
+			{
+				std::this_thread::yield();
+			}
+			counter->_waiters.store(0);
+			counter->_value.store(decl_count);
+			break;
+		}
+	}
 
 	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+	ga_job_worker_t* worker = _ga_job_get_worker();
+	int main_thread_work = 0;
 	for (int i = 0; i < decl_count; ++i)
 	{
 		decls[i]._pending_count = counter;
-		impl->_job_queue.push(decls + i);
+		ga_job_priority_t priority = decls[i]._priority;
+		if (decls[i]._main_thread_only)
+		{
+			impl->_main_queue.push(decls + i);
+			main_thread_work++;
+		}
+		else if (!worker || !worker->_deques[priority]->push(decls + i))
+		{
+			impl->_job_queues[priority]->push(decls + i);
+		}
 	}
 
-	impl->_work_added.wake_all();
+	/* Wake one worker per job, not all of them. */
+	if (decl_count > main_thread_work)
+	{
+		impl->_work_added.notify(decl_count - main_thread_work);
+	}
+	if (main_thread_work)
+	{
+		impl->_main_wake.notify_all();
+	}
 }
 
-void ga_job::wait(int32_t* counter)
+void ga_job::wait(ga_job_counter_t* counter)
 {
-	if (*counter > 0)
+	if (counter->_waiters.load() != ga_job_counter_t::k_complete)
 	{
 		/*
-		** If we're not the main thread, assume we're waiting from within a job.
-		** In this case, push the current job onto the wait list, and reschedule.
+		** If we're waiting from within a job, switch back to the scheduler,
+		** which chains us onto the counter once we're safely off this fiber.
 		*/
 		ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
-		if (std::this_thread::get_id() != impl->_main_thread)
+		ga_job_instance_t* job = static_cast<ga_job_instance_t*>(ga_fiber::get_data());
+		if (job)
 		{
-			ga_job_instance_t* job = static_cast<ga_job_instance_t*>(ga_fiber::get_data());
-			job->_waiting_count = counter;
-			impl->_wait_queue.push(job);
-
-			ga_fiber::switch_to(*job->_parent_fiber);
+			while (counter->_waiters.load() != ga_job_counter_t::k_complete)
+			{
+				job->_waiting_counter = counter;
+				ga_fiber::switch_to(*job->_parent_fiber);
+			}
 		}
 		/*
-		** Otherwise, in the main thread, block until jobs are complete.
+		** Otherwise, on the main thread, run jobs until ours are complete.
+		** Sleep only when there's nothing to run; every counter completion
+		** and every job for the main thread wakes us.
 		*/
 		else
 		{
-			while (*counter > 0)
+			ga_job_worker_t* worker = _ga_job_get_worker();
+			while (counter->_waiters.load() != ga_job_counter_t::k_complete)
+			{
+				if (worker && _ga_job_schedule(worker, worker->_root_fiber))
+				{
+					continue;
+				}
+
+				uint32_t key = impl->_main_wake.prepare_wait();
+				if (counter->_waiters.load() == ga_job_counter_t::k_complete ||
+					(worker && _ga_job_schedule(worker, worker->_root_fiber)))
+				{
+					impl->_main_wake.cancel_wait();
+					continue;
+				}
+
+				GA_PROFILE_EVENT(k_profile_idle_begin, 0, 0);
+				impl->_main_wake.wait(key);
+				GA_PROFILE_EVENT(k_profile_idle_end, 0, 0);
+			}
+		}
+	}
+}
+
+void ga_job::get_stats(ga_job_stats_t* stats)
+{
+	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+
+	for (int i = 0; i < k_job_stack_count; ++i)
+	{
+		ga_job_fiber_pool_t* pool = impl->_fiber_pools[i];
+		stats->_fiber_count[i] = pool->_pool.get_index_count();
+		stats->_fiber_high_water[i] = pool->_pool.get_high_water();
+		stats->_max_fiber_count[i] = pool->_pool.get_max_index_count();
+		stats->_stack_high_water[i] = pool->_stack_high_water;
+	}
+
+	stats->_record_count = impl->_job_record_pool.get_index_count();
+	stats->_record_high_water = impl->_job_record_pool.get_high_water();
+	stats->_max_record_count = impl->_job_record_pool.get_max_index_count();
+
+	for (int i = 0; i < k_job_priority_count; ++i)
+	{
+		stats->_queue_size[i] = impl->_job_queues[i]->get_node_count();
+		stats->_queue_high_water[i] = impl->_job_queues[i]->get_high_water();
+	}
+	stats->_max_queue_size = impl->_job_queues[0]->get_max_node_count();
+
+	stats->_ready_high_water = std::max(impl->_ready_queue.get_high_water(), impl->_main_ready_queue.get_high_water());
+	stats->_main_queue_high_water = impl->_main_queue.get_high_water();
+}
+
+int ga_job::get_worker_count()
+{
+	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+	return impl ? int(impl->_workers.size()) : 0;
+}
+
+int ga_job::get_worker_index()
+{
+	ga_job_worker_t* worker = _ga_job_get_worker();
+	return worker ? worker->_index : -1;
+}
+
+bool ga_job::suspend_on_mutex(ga_fiber_mutex* mutex)
+{
+	/* The scheduler chains us onto the mutex once we're off this fiber. */
+	ga_job_instance_t* job = static_cast<ga_job_instance_t*>(ga_fiber::get_data());
+	if (!job)
+	{
+		return false;
+	}
+
+	job->_waiting_mutex = &mutex->_state;
+	ga_fiber::switch_to(*job->_parent_fiber);
+	return true;
+}
+
+void ga_job::unlock_mutex_to_waiter(ga_fiber_mutex* mutex)
+{
+	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+
+	/*
+	** Only the holder pops waiters, while others only push, so the head
+	** can't be popped and pushed back under us between the load and the CAS.
+	*/
+	uintptr_t state = mutex->_state.load();
+	for (;;)
+	{
+		if (state == ga_fiber_mutex::k_locked)
+		{
+			if (mutex->_state.compare_exchange_weak(state, ga_fiber_mutex::k_unlocked, std::memory_order_release))
 			{
-				impl->_work_exhausted.wait();
+				return;
 			}
+			continue;
+		}
+
+		ga_job_instance_t* waiter = reinterpret_cast<ga_job_instance_t*>(state);
+		uintptr_t next = waiter->_next_waiter ? reinterpret_cast<uintptr_t>(waiter->_next_waiter) : ga_fiber_mutex::k_locked;
+		if (mutex->_state.compare_exchange_weak(state, next))
+		{
+			_ga_job_make_ready(impl, waiter);
+			impl->_work_added.notify(1);
+			return;
+		}
+	}
+}
+
+void* ga_job::alloc_record(
+	void(*invoke)(void* storage),
+	ga_job_priority_t priority,
+	bool main_thread_only,
+	ga_job_decl_t** decl)
+{
+	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+
+	/* Records come back as lambda jobs finish, so wait for one. */
+	int index = impl->_job_record_pool.alloc();
+	if (index < 0)
+	{
+		if (!impl->_reported_records_exhausted.exchange(true))
+		{
+			printf("ga_job: all %d job records in use; raise _max_record_count.\n", impl->_job_record_pool.get_max_index_count());
+		}
+		while ((index = impl->_job_record_pool.alloc()) < 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	ga_job_record_t* record = _ga_job_get_record(impl, index);
+	record->_invoke = invoke;
+	record->_decl._entry = _ga_job_record_entry;
+	record->_decl._data = record;
+	record->_decl._priority = priority;
+	record->_decl._main_thread_only = main_thread_only;
+
+	*decl = &record->_decl;
+	return record->_storage;
+}
+
+/*
+** Shared state for a parallel_for.
+** Each batch job claims grain-sized ranges from the cursor until none are left,
+** so we never need more jobs than there are workers.
+*/
+struct ga_job_parallel_for_t
+{
+	std::atomic_int _cursor;
+	int _end;
+	int _grain;
+
+	ga_job_range_function_t _func;
+	void* _data;
+};
+
+static const int k_ga_job_max_parallel_for_jobs = 64;
+
+void ga_job::parallel_for(
+	int begin,
+	int end,
+	int grain,
+	ga_job_range_function_t func,
+	void* data,
+	ga_job_priority_t priority)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+
+	grain = std::max(grain, 1);
+	int batch_count = (end - begin) / grain + ((end - begin) % grain != 0 ? 1 : 0);
+
+	/* Not worth a job switch. */
+	if (batch_count == 1)
+	{
+		func(begin, end, data);
+		return;
+	}
+
+	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(_impl);
+	int job_count = std::min(batch_count, std::min(int(impl->_workers.size()), k_ga_job_max_parallel_for_jobs));
+
+	ga_job_parallel_for_t state;
+	state._cursor = begin;
+	state._end = end;
+	state._grain = grain;
+	state._func = func;
+	state._data = data;
+
+	ga_job_decl_t decls[k_ga_job_max_parallel_for_jobs];
+	for (int i = 0; i < job_count; ++i)
+	{
+		decls[i]._entry = _ga_job_parallel_for_worker;
+		decls[i]._data = &state;
+		decls[i]._priority = priority;
+	}
+
+	ga_job_counter_t counter;
+	run(decls, job_count, &counter);
+	wait(&counter);
+}
+
+static void _ga_job_parallel_for_worker(void* data)
+{
+	ga_job_parallel_for_t* state = static_cast<ga_job_parallel_for_t*>(data);
+	for (;;)
+	{
+		int begin = state->_cursor.fetch_add(state->_grain);
+		if (begin >= state->_end)
+		{
+			break;
 		}
+
+		int end = state->_end - begin > state->_grain ? begin + state->_grain : state->_end;
+		state->_func(begin, end, state->_data);
 	}
 }
 
+/*
+** Fibers migrate between threads, so never let the compiler cache the
+** address of the thread-local across a fiber switch.
+*/
+static GA_NOINLINE ga_job_worker_t* _ga_job_get_worker()
+{
+	return _ga_job_current_worker;
+}
+
+static const int k_ga_job_spin_count = 32;
+
 static int _ga_job_instance_thread_worker(void* data)
 {
-	ga_job_system_impl_t* impl = static_cast<ga_job_system_impl_t*>(data);
+	ga_job_worker_t* worker = static_cast<ga_job_worker_t*>(data);
+	ga_job_system_impl_t* impl = worker->_system;
+
+	_ga_job_current_worker = worker;
+
+	if (worker->_cpu >= 0 && !ga_cpu_topology::pin_current_thread(worker->_cpu))
+	{
+		printf("ga_job: failed to pin worker %d to cpu %d.\n", worker->_index, worker->_cpu);
+	}
 
 	ga_fiber parent_fiber = ga_fiber::convert_thread(0);
+	worker->_root_fiber = &parent_fiber;
+
+#if GA_PROFILER
+	char thread_name[32];
+	snprintf(thread_name, sizeof(thread_name), "worker %d", worker->_index);
+	ga_profiler::set_thread_name(thread_name);
+#endif
 
 	while (!impl->_terminate)
 	{
-		if (!_ga_job_schedule(impl, &parent_fiber))
+		if (_ga_job_schedule(worker, &parent_fiber))
+		{
+			continue;
+		}
+
+		/* Work often turns up within a few hundred cycles; check again before parking. */
+		bool found_work = false;
+		for (int i = 0; i < k_ga_job_spin_count && !found_work; ++i)
 		{
-			impl->_work_exhausted.wake_all();
-			impl->_work_added.wait_for(1000);
+			GA_JOB_PAUSE();
+			found_work = _ga_job_schedule(worker, &parent_fiber);
 		}
+		if (found_work)
+		{
+			continue;
+		}
+
+		uint32_t key = impl->_work_added.prepare_wait();
+		if (impl->_terminate || _ga_job_schedule(worker, &parent_fiber))
+		{
+			impl->_work_added.cancel_wait();
+			continue;
+		}
+
+		/*
+		** The timeout only matters for work a notify can't point at, like a
+		** background job held back by the limit.
+		*/
+		GA_PROFILE_EVENT(k_profile_idle_begin, 0, 0);
+		impl->_work_added.wait(key, 1000);
+		GA_PROFILE_EVENT(k_profile_idle_end, 0, 0);
 	}
 
 	return 0;
 }
 
-static bool _ga_job_schedule(ga_job_system_impl_t* impl, ga_fiber* parent_fiber)
+static bool _ga_job_schedule(ga_job_worker_t* worker, ga_fiber* parent_fiber)
 {
-	/* Check for waiting jobs that are ready to run. */
+	ga_job_system_impl_t* impl = worker->_system;
 	ga_job_instance_t* job;
-	int retry_wait_count = impl->_wait_queue.get_count();
-	while (retry_wait_count-- > 0 && impl->_wait_queue.pop((void**)&job))
+	ga_job_decl_t* decl;
+
+	/* Jobs pinned to the main thread come first there. */
+	if (worker->_is_main)
 	{
-		if (job->_waiting_count == 0 || job->_waiting_count[0] == 0)
+		if (impl->_main_ready_queue.pop((void**)&job))
 		{
-			_ga_job_run(impl, parent_fiber, job);
+			_ga_job_resume(impl, parent_fiber, job);
 			return true;
 		}
-		else
+
+		if (impl->_main_queue.pop((void**)&decl))
 		{
-			impl->_wait_queue.push(job);
+			return _ga_job_start(worker, parent_fiber, decl);
 		}
 	}
 
+	/* Resume jobs whose counters have completed. */
+	if (impl->_ready_queue.pop((void**)&job))
+	{
+		_ga_job_resume(impl, parent_fiber, job);
+		return true;
+	}
+
 	/* Look for queued jobs. */
-	ga_job_decl_t* decl;
-	if (impl->_job_queue.pop((void**)&decl))
+	if (_ga_job_find_work(worker, &decl))
 	{
-		int ga_job_index = impl->_job_instance_pool.alloc();
+		return _ga_job_start(worker, parent_fiber, decl);
+	}
+
+	return false;
+}
+
+static bool _ga_job_find_work(ga_job_worker_t* worker, ga_job_decl_t** decl)
+{
+	ga_job_system_impl_t* impl = worker->_system;
+
+	/* Drain lanes strictly in priority order. */
+	for (int priority = 0; priority < k_job_priority_background; ++priority)
+	{
+		if (_ga_job_find_work_in_lane(worker, priority, decl))
+		{
+			return true;
+		}
+	}
+
+	/* The main thread must get back to its frame; leave long work to the workers. */
+	if (worker->_is_main)
+	{
+		return false;
+	}
+
+	/* Reserve a background slot before looking, so the limit is never exceeded. */
+	if (impl->_background_running.fetch_add(1) < impl->_background_limit)
+	{
+		if (_ga_job_find_work_in_lane(worker, k_job_priority_background, decl))
+		{
+			return true;
+		}
+	}
+	impl->_background_running--;
 
-		job = &impl->_job_instance_data[ga_job_index];
-		job->_decl = decl;
-		job->_pool_index = ga_job_index;
+	return false;
+}
 
-		_ga_job_run(impl, parent_fiber, job);
+static bool _ga_job_find_work_in_lane(ga_job_worker_t* worker, int priority, ga_job_decl_t** decl)
+{
+	ga_job_system_impl_t* impl = worker->_system;
 
+	/* Newest work from our own deque is most likely to still be in cache. */
+	if (worker->_deques[priority]->pop((void**)decl))
+	{
+		return true;
+	}
+
+	if (impl->_job_queues[priority]->pop((void**)decl))
+	{
 		return true;
 	}
 
-	return impl->_wait_queue.get_count() != 0;
+	/* Steal the oldest work from another worker, starting at a random victim. */
+	int worker_count = int(impl->_workers.size());
+	worker->_steal_seed ^= worker->_steal_seed << 13;
+	worker->_steal_seed ^= worker->_steal_seed >> 17;
+	worker->_steal_seed ^= worker->_steal_seed << 5;
+	int start = int(worker->_steal_seed % uint32_t(worker_count));
+	for (int i = 0; i < worker_count; ++i)
+	{
+		ga_job_worker_t* victim = impl->_workers[(start + i) % worker_count];
+		if (victim != worker && victim->_deques[priority]->steal((void**)decl))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool _ga_job_start(ga_job_worker_t* worker, ga_fiber* parent_fiber, ga_job_decl_t* decl)
+{
+	ga_job_system_impl_t* impl = worker->_system;
+
+	/*
+	** Every fiber of the job's stack class is in use. Put the job back where
+	** any thread can find it; it starts once a running job frees a fiber.
+	*/
+	ga_job_fiber_pool_t* pool = impl->_fiber_pools[decl->_stack];
+	int ga_job_index = pool->_pool.alloc();
+	if (ga_job_index < 0)
+	{
+		if (!pool->_reported_exhausted.exchange(true))
+		{
+			printf("ga_job: all %d %s stack fibers in use; raise _max_fiber_count.\n", pool->_pool.get_max_index_count(), k_ga_job_stack_names[decl->_stack]);
+		}
+
+		if (decl->_main_thread_only)
+		{
+			impl->_main_queue.push(decl);
+		}
+		else
+		{
+			if (decl->_priority == k_job_priority_background)
+			{
+				impl->_background_running--;
+			}
+			impl->_job_queues[decl->_priority]->push(decl);
+		}
+		impl->_fiber_starved = true;
+		return false;
+	}
+
+	ga_job_instance_t* job = _ga_job_get_instance(impl, decl->_stack, ga_job_index);
+	job->_decl = *decl;
+	if (impl->_report_stack_usage)
+	{
+		job->_stack_use_key = _ga_job_get_stack_use_key(decl);
+	}
+
+	GA_PROFILE_EVENT(k_profile_job_start, "job", reinterpret_cast<uint64_t>(decl->_entry));
+	_ga_job_run(impl, parent_fiber, job);
+	return true;
+}
+
+static ga_job_instance_t* _ga_job_get_instance(ga_job_system_impl_t* impl, ga_job_stack_t stack, int index)
+{
+	/* Only the thread holding an index touches its slot, so no lock is needed. */
+	ga_job_fiber_pool_t* pool = impl->_fiber_pools[stack];
+	ga_job_instance_t* instance = pool->_instances[index];
+	if (!instance)
+	{
+		instance = new ga_job_instance_t;
+		instance->_fiber = ga_fiber(_ga_job_fiber_worker, instance, pool->_stack_size, impl->_report_stack_usage);
+		instance->_pool_index = index;
+		pool->_instances[index] = instance;
+	}
+	return instance;
+}
+
+/* Lambda and parallel_for jobs share entry points; count them by what they call. */
+static uintptr_t _ga_job_get_stack_use_key(const ga_job_decl_t* decl)
+{
+	if (decl->_entry == _ga_job_record_entry)
+	{
+		return reinterpret_cast<uintptr_t>(static_cast<ga_job_record_t*>(decl->_data)->_invoke);
+	}
+	if (decl->_entry == _ga_job_parallel_for_worker)
+	{
+		return reinterpret_cast<uintptr_t>(static_cast<ga_job_parallel_for_t*>(decl->_data)->_func);
+	}
+	return reinterpret_cast<uintptr_t>(decl->_entry);
+}
+
+static void _ga_job_record_stack_use(ga_job_system_impl_t* impl, ga_job_instance_t* job)
+{
+	size_t use = job->_fiber.get_stack_use();
+	job->_fiber.reset_stack_use();
+
+	ga_job_fiber_pool_t* pool = impl->_fiber_pools[job->_decl._stack];
+	size_t high_water = pool->_stack_high_water.load();
+	while (use > high_water && !pool->_stack_high_water.compare_exchange_weak(high_water, use)) {}
+
+	std::lock_guard<std::mutex> lock(impl->_stack_use_lock);
+	ga_job_stack_use_t& entry = impl->_stack_use[std::make_pair(job->_stack_use_key, int(job->_decl._stack))];
+	entry._peak = std::max(entry._peak, use);
+	entry._run_count++;
+}
+
+static void _ga_job_report_stack_use(ga_job_system_impl_t* impl)
+{
+	typedef std::pair<std::pair<uintptr_t, int>, ga_job_stack_use_t> entry_t;
+
+	/* Deepest first. Resolve addresses with addr2line or the debugger. */
+	std::vector<entry_t> entries(impl->_stack_use.begin(), impl->_stack_use.end());
+	std::sort(entries.begin(), entries.end(), [](const entry_t& a, const entry_t& b)
+	{
+		return a.second._peak > b.second._peak;
+	});
+
+	printf("ga_job: peak stack use by entry point:\n");
+	for (auto& e : entries)
+	{
+		size_t stack_size = impl->_fiber_pools[e.first.second]->_stack_size;
+		printf("  %#18llx %-7s %8llu of %8llu bytes (%5.1f%%), %u runs\n",
+			(unsigned long long)e.first.first,
+			k_ga_job_stack_names[e.first.second],
+			(unsigned long long)e.second._peak,
+			(unsigned long long)stack_size,
+			100.0 * double(e.second._peak) / double(stack_size),
+			e.second._run_count);
+	}
+}
+
+static void _ga_job_resume(ga_job_system_impl_t* impl, ga_fiber* parent_fiber, ga_job_instance_t* job)
+{
+	GA_PROFILE_EVENT(k_profile_job_resume, "job", reinterpret_cast<uint64_t>(job->_decl._entry));
+	_ga_job_run(impl, parent_fiber, job);
 }
 
 static void _ga_job_run(ga_job_system_impl_t* impl, ga_fiber* parent_fiber, ga_job_instance_t* job)
 {
 	job->_parent_fiber = parent_fiber;
-	job->_waiting_count = 0;
+	job->_waiting_counter = 0;
+	job->_waiting_mutex = 0;
 
 	ga_fiber::switch_to(job->_fiber);
 
-	if (job->_waiting_count == 0 || job->_waiting_count[0] == 0)
+	/*
+	** The job suspended itself in ga_job::wait. Now that its fiber is no longer
+	** running, chain it onto the counter. If the counter completed in the
+	** meantime, it's ready to run again right away.
+	*/
+	if (job->_waiting_counter)
+	{
+		GA_PROFILE_EVENT(k_profile_job_suspend, 0, 0);
+		if (!_ga_job_add_waiter(job->_waiting_counter, job))
+		{
+			_ga_job_make_ready(impl, job);
+		}
+		return;
+	}
+
+	/* Likewise for a mutex; if it was freed meanwhile, the job now holds it. */
+	if (job->_waiting_mutex)
+	{
+		GA_PROFILE_EVENT(k_profile_job_suspend, 0, 0);
+		if (!_ga_job_add_mutex_waiter(job->_waiting_mutex, job))
+		{
+			_ga_job_make_ready(impl, job);
+		}
+		return;
+	}
+
+	GA_PROFILE_EVENT(k_profile_job_end, 0, 0);
+
+	ga_job_counter_t* counter = job->_decl._pending_count;
+	if (job->_decl._priority == k_job_priority_background)
+	{
+		/* A background job held back by the limit may run now. */
+		impl->_background_running--;
+		impl->_work_added.notify(1);
+	}
+
+	if (impl->_report_stack_usage)
 	{
-		impl->_job_instance_pool.free(job->_pool_index);
+		_ga_job_record_stack_use(impl, job);
+	}
+
+	impl->_fiber_pools[job->_decl._stack]->_pool.free(job->_pool_index);
+	if (impl->_fiber_starved.load(std::memory_order_relaxed) && impl->_fiber_starved.exchange(false))
+	{
+		impl->_work_added.notify(1);
+	}
+
+	if (--counter->_value == 0)
+	{
+		_ga_job_complete(impl, counter);
+	}
+}
+
+static void _ga_job_make_ready(ga_job_system_impl_t* impl, ga_job_instance_t* job)
+{
+	if (job->_decl._main_thread_only)
+	{
+		impl->_main_ready_queue.push(job);
+		impl->_main_wake.notify_all();
+	}
+	else
+	{
+		impl->_ready_queue.push(job);
+	}
+}
+
+static bool _ga_job_add_waiter(ga_job_counter_t* counter, ga_job_instance_t* job)
+{
+	uintptr_t head = counter->_waiters.load();
+	do
+	{
+		if (head == ga_job_counter_t::k_complete)
+		{
+			return false;
+		}
+		job->_next_waiter = reinterpret_cast<ga_job_instance_t*>(head);
+	} while (!counter->_waiters.compare_exchange_weak(head, reinterpret_cast<uintptr_t>(job)));
+
+	return true;
+}
+
+static bool _ga_job_add_mutex_waiter(std::atomic<uintptr_t>* mutex_state, ga_job_instance_t* job)
+{
+	uintptr_t state = mutex_state->load();
+	for (;;)
+	{
+		if (state == ga_fiber_mutex::k_unlocked)
+		{
+			if (mutex_state->compare_exchange_weak(state, ga_fiber_mutex::k_locked, std::memory_order_acquire))
+			{
+				return false;
+			}
+			continue;
+		}
 
-		(*reinterpret_cast<std::atomic_int*>(job->_decl->_pending_count))--;
+		job->_next_waiter = state == ga_fiber_mutex::k_locked ? 0 : reinterpret_cast<ga_job_instance_t*>(state);
+		if (mutex_state->compare_exchange_weak(state, reinterpret_cast<uintptr_t>(job)))
+		{
+			return true;
+		}
 	}
 }
 
+static void _ga_job_complete(ga_job_system_impl_t* impl, ga_job_counter_t* counter)
+{
+	/*
+	** Close the wait list. This is the last touch of the counter: its owner may
+	** free it as soon as it sees the list closed.
+	*/
+	uintptr_t head = counter->_waiters.exchange(ga_job_counter_t::k_complete);
+
+	ga_job_instance_t* waiter = reinterpret_cast<ga_job_instance_t*>(head);
+	int woke_jobs = 0;
+	while (waiter)
+	{
+		ga_job_instance_t* next = waiter->_next_waiter;
+		_ga_job_make_ready(impl, waiter);
+		woke_jobs++;
+		waiter = next;
+	}
+
+	if (woke_jobs)
+	{
+		impl->_work_added.notify(woke_jobs);
+	}
+	impl->_main_wake.notify_all();
+}
+
+static ga_job_record_t* _ga_job_get_record(ga_job_system_impl_t* impl, int index)
+{
+	ga_job_record_t* record = impl->_job_records[index];
+	if (!record)
+	{
+		record = new ga_job_record_t;
+		record->_system = impl;
+		record->_pool_index = index;
+		impl->_job_records[index] = record;
+	}
+	return record;
+}
+
+static void _ga_job_record_entry(void* data)
+{
+	ga_job_record_t* record = static_cast<ga_job_record_t*>(data);
+	record->_invoke(record->_storage);
+	record->_system->_job_record_pool.free(record->_pool_index);
+}
+
 static void _ga_job_fiber_worker(void* data)
 {
 	for (;;)
 	{
 		ga_job_instance_t* job = static_cast<ga_job_instance_t*>(ga_fiber::get_data());
-		job->_decl->_entry(job->_decl->_data);
+		job->_decl._entry(job->_decl._data);
 		ga_fiber::switch_to(*job->_parent_fiber);
 	}
 }
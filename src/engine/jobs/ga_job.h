@@ -11,13 +11,79 @@
 ** Based on: "Parallelizing the Naughty Dog Engine Using Fibers", Christian Gyrling
 */
 
+#include "ga_topology.h"
+
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <new>
+#include <utility>
+
+class ga_fiber_mutex;
 
 /*
 ** Job entry point.
 */
 typedef void(*ga_job_function_t)(void* data);
 
+/*
+** Entry point for a batch of a parallel_for; handles indices [begin, end).
+*/
+typedef void(*ga_job_range_function_t)(int begin, int end, void* data);
+
+/*
+** Job priority lanes. Schedulers always drain higher lanes first.
+** Background jobs may run across frame boundaries, but never occupy every
+** worker, so critical frame work always has a thread to run on.
+*/
+enum ga_job_priority_t
+{
+	k_job_priority_critical,
+	k_job_priority_normal,
+	k_job_priority_background,
+
+	k_job_priority_count,
+};
+
+/*
+** Fiber stack sizes a job may ask for. Each has its own pool of fibers;
+** see ga_job_config_t for the sizes.
+*/
+enum ga_job_stack_t
+{
+	k_job_stack_small,
+	k_job_stack_default,
+	k_job_stack_large,
+
+	k_job_stack_count,
+};
+
+/*
+** Counts outstanding jobs.
+** Fibers that wait on a counter are chained onto it, and whichever job takes
+** the count to zero makes them runnable; nothing polls. The wait list is
+** closed once the count reaches zero, which marks the counter complete.
+** A counter may be reused once it is complete.
+**
+** run adds to the count rather than setting it, so jobs can be added to a
+** counter that's still pending, as a job graph's nodes add their
+** successors. run reopens a complete counter, or one whose last job is
+** still closing it, before adding; a wait that starts after run returns
+** waits for the new jobs too.
+*/
+struct ga_job_counter_t
+{
+	static const uintptr_t k_complete = 1;
+
+	/* _value while run reopens the wait list; no job is outstanding then. */
+	static const int32_t k_reopening = -1;
+
+	ga_job_counter_t() : _value(0), _waiters(k_complete) {}
+
+	std::atomic<int32_t> _value;
+	std::atomic<uintptr_t> _waiters;
+};
+
 /*
 ** Defines a job.
 */
@@ -26,7 +92,82 @@ struct ga_job_decl_t
 	ga_job_function_t _entry;
 	void* _data;
 
-	int32_t* _pending_count;
+	ga_job_priority_t _priority = k_job_priority_normal;
+
+	/* Only ever run (and resume) this job on the main thread, e.g. for GL calls. */
+	bool _main_thread_only = false;
+
+	/* Small for short leaf work; large for deep call chains like parsers or drivers. */
+	ga_job_stack_t _stack = k_job_stack_default;
+
+	ga_job_counter_t* _pending_count;
+};
+
+/*
+** Job system startup options.
+*/
+struct ga_job_config_t
+{
+	/* CPUs workers may run on. Empty means every online CPU. */
+	ga_cpu_set _cpus;
+
+	/* One worker per hardware thread instead of one per physical core. */
+	bool _use_smt_siblings = false;
+
+	/* Pin each worker to its CPU so the OS doesn't migrate it and lose its cache. */
+	bool _pin_threads = true;
+
+	/* Print the chosen worker layout. */
+	bool _report_layout = true;
+
+	/*
+	** Queues and the fiber pools start at these sizes and grow on demand up
+	** to the limits. Past a queue's limit run waits for room; past a fiber
+	** pool's limit no new jobs of its stack class start until one finishes.
+	** Fiber counts and stack sizes are per ga_job_stack_t.
+	*/
+	int _queue_size = 256;
+	int _max_queue_size = 64 * 1024;
+	int _fiber_count[k_job_stack_count] = { 64, 256, 8 };
+	int _max_fiber_count[k_job_stack_count] = { 4096, 4096, 256 };
+	size_t _stack_size[k_job_stack_count] = { 16 * 1024, 64 * 1024, 512 * 1024 };
+
+	/* Records that hold lambda jobs between run and their completion. */
+	int _record_count = 256;
+	int _max_record_count = 64 * 1024;
+
+	/* Print pool high-water marks at shutdown, for sizing the pools. */
+	bool _report_pool_usage = true;
+
+	/*
+	** Track stack use and print each entry point's peak at shutdown, for
+	** sizing the stack classes. Paints every stack, so only for debugging.
+	*/
+	bool _report_stack_usage = false;
+};
+
+/*
+** Job system pool usage, for sizing the pools.
+*/
+struct ga_job_stats_t
+{
+	int _fiber_count[k_job_stack_count];
+	int _fiber_high_water[k_job_stack_count];
+	int _max_fiber_count[k_job_stack_count];
+
+	/* Deepest stack use in bytes, if _report_stack_usage is set. */
+	size_t _stack_high_water[k_job_stack_count];
+
+	int _record_count;
+	int _record_high_water;
+	int _max_record_count;
+
+	int _queue_size[k_job_priority_count];
+	int _queue_high_water[k_job_priority_count];
+	int _max_queue_size;
+
+	int _ready_high_water;
+	int _main_queue_high_water;
 };
 
 /*
@@ -35,6 +176,9 @@ struct ga_job_decl_t
 class ga_job
 {
 public:
+	static void startup(const ga_job_config_t& config);
+
+	/* One unpinned worker per hardware thread in the mask. */
 	static void startup(
 		uint32_t hardware_thread_mask,
 		int queue_size,
@@ -42,10 +186,119 @@ public:
 
 	static void shutdown();
 
-	static void run(ga_job_decl_t* decls, int decl_count, int32_t* counter);
+	static void run(ga_job_decl_t* decls, int decl_count, ga_job_counter_t* counter);
 
-	static void wait(int32_t* counter);
+	/*
+	** Runs a callable, such as a lambda. Its captures are copied into a
+	** pooled job record, so they only need to outlive the call to run, and
+	** nothing is allocated per job.
+	*/
+	template<class T>
+	static void run(
+		T func,
+		ga_job_counter_t* counter,
+		ga_job_priority_t priority = k_job_priority_normal,
+		bool main_thread_only = false);
+
+	static void wait(ga_job_counter_t* counter);
+
+	static void get_stats(ga_job_stats_t* stats);
+
+	/*
+	** Workers, including the main thread's, are numbered from 0 to
+	** get_worker_count() - 1, for indexing per-worker data. Outside the job
+	** system's threads the index is -1. A job may resume on another worker
+	** after a wait, so look the index up again after one.
+	*/
+	static int get_worker_count();
+	static int get_worker_index();
+
+	/*
+	** Calls func over [begin, end) in contiguous batches of at most grain
+	** indices, spread across the workers, and waits for all of them.
+	*/
+	static void parallel_for(
+		int begin,
+		int end,
+		int grain,
+		ga_job_range_function_t func,
+		void* data,
+		ga_job_priority_t priority = k_job_priority_normal);
+
+	/* As above, with a callable taking (begin, end). It is shared, not copied. */
+	template<class T>
+	static void parallel_for(
+		int begin,
+		int end,
+		int grain,
+		const T& func,
+		ga_job_priority_t priority = k_job_priority_normal);
+
+	/* Largest callable, and strictest alignment, a job record can hold. */
+	static const size_t k_record_capture_size = 64;
+	static const size_t k_record_capture_align = alignof(std::max_align_t);
 
 private:
+	friend class ga_fiber_mutex;
+
+	/*
+	** Suspends the calling job until unlock hands it the mutex.
+	** Returns false, doing nothing, when not called from a job.
+	*/
+	static bool suspend_on_mutex(ga_fiber_mutex* mutex);
+
+	/* Passes a mutex with waiters to one of them and makes it runnable. */
+	static void unlock_mutex_to_waiter(ga_fiber_mutex* mutex);
+
+	/* Returns storage for a callable in a new record, and the record's decl. */
+	static void* alloc_record(
+		void(*invoke)(void* storage),
+		ga_job_priority_t priority,
+		bool main_thread_only,
+		ga_job_decl_t** decl);
+
+	template<class T>
+	static void invoke_record(void* storage)
+	{
+		T* func = static_cast<T*>(storage);
+		(*func)();
+		func->~T();
+	}
+
+	template<class T>
+	static void invoke_range(int begin, int end, void* data)
+	{
+		(*static_cast<const T*>(data))(begin, end);
+	}
+
 	static void* _impl;
 };
+
+template<class T>
+void ga_job::run(
+	T func,
+	ga_job_counter_t* counter,
+	ga_job_priority_t priority,
+	bool main_thread_only)
+{
+	static_assert(sizeof(T) <= k_record_capture_size,
+		"ga_job::run: captures don't fit in a job record; capture a pointer to them instead.");
+	static_assert(alignof(T) <= k_record_capture_align,
+		"ga_job::run: captures are over-aligned for a job record.");
+
+	ga_job_decl_t* decl;
+	void* storage = alloc_record(&invoke_record<T>, priority, main_thread_only, &decl);
+	new (storage) T(std::move(func));
+	run(decl, 1, counter);
+}
+
+template<class T>
+void ga_job::parallel_for(
+	int begin,
+	int end,
+	int grain,
+	const T& func,
+	ga_job_priority_t priority)
+{
+	parallel_for(begin, end, grain, &invoke_range<T>, const_cast<T*>(&func), priority);
+}
@@ -0,0 +1,111 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_job_graph.h"
+
+#include <atomic>
+#include <cassert>
+
+/*
+** A node runs through its own decl, which calls the user's job and then
+** starts any successors it was the last predecessor of. Successors are
+** added to the run's counter before the finishing node is taken off it,
+** so the counter can't complete while work is still to come.
+*/
+struct ga_job_graph_node_t
+{
+	ga_job_function_t _entry;
+	void* _data;
+	ga_job_decl_t _decl;
+
+	int _predecessor_count;
+	std::atomic_int _remaining;
+	std::vector<ga_job_graph_node_t*> _successors;
+
+	/* The counter of the run in progress. */
+	ga_job_counter_t* _counter;
+};
+
+static void _ga_job_graph_node_entry(void* data);
+
+ga_job_graph::ga_job_graph()
+{
+}
+
+ga_job_graph::~ga_job_graph()
+{
+	for (auto& n : _nodes)
+	{
+		delete n;
+	}
+}
+
+int ga_job_graph::add_node(const ga_job_decl_t& decl, std::initializer_list<int> predecessors)
+{
+	return add_node(decl, predecessors.begin(), int(predecessors.size()));
+}
+
+int ga_job_graph::add_node(const ga_job_decl_t& decl, const int* predecessors, int predecessor_count)
+{
+	int id = int(_nodes.size());
+
+	ga_job_graph_node_t* node = new ga_job_graph_node_t;
+	node->_entry = decl._entry;
+	node->_data = decl._data;
+	node->_decl = decl;
+	node->_decl._entry = _ga_job_graph_node_entry;
+	node->_decl._data = node;
+	node->_predecessor_count = predecessor_count;
+	node->_remaining = 0;
+	node->_counter = 0;
+
+	for (int i = 0; i < predecessor_count; ++i)
+	{
+		assert(predecessors[i] >= 0 && predecessors[i] < id);
+		_nodes[predecessors[i]]->_successors.push_back(node);
+	}
+
+	_nodes.push_back(node);
+	if (predecessor_count == 0)
+	{
+		_root_decls.push_back(node->_decl);
+	}
+
+	return id;
+}
+
+void ga_job_graph::run(ga_job_counter_t* counter)
+{
+	if (_root_decls.empty())
+	{
+		return;
+	}
+
+	for (auto& n : _nodes)
+	{
+		n->_remaining = n->_predecessor_count;
+		n->_counter = counter;
+	}
+
+	ga_job::run(_root_decls.data(), int(_root_decls.size()), counter);
+}
+
+static void _ga_job_graph_node_entry(void* data)
+{
+	ga_job_graph_node_t* node = static_cast<ga_job_graph_node_t*>(data);
+	node->_entry(node->_data);
+
+	for (auto& s : node->_successors)
+	{
+		if (--s->_remaining == 0)
+		{
+			ga_job::run(&s->_decl, 1, node->_counter);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_job.h"
+
+#include <initializer_list>
+#include <vector>
+
+/*
+** A graph of jobs, each of which starts once all of its predecessors finish.
+** Build it once and run it as often as needed; independent nodes overlap
+** instead of meeting at a barrier between every stage.
+**
+** Nodes can only name nodes added before them, so a graph never has a cycle.
+** Don't run a graph again until its previous run's counter is complete.
+*/
+class ga_job_graph
+{
+public:
+	ga_job_graph();
+	~ga_job_graph();
+
+	/* Adds a node for the job and returns its id. */
+	int add_node(const ga_job_decl_t& decl, std::initializer_list<int> predecessors = {});
+	int add_node(const ga_job_decl_t& decl, const int* predecessors, int predecessor_count);
+
+	/* Starts every node. The counter completes once they have all finished. */
+	void run(ga_job_counter_t* counter);
+
+	int get_node_count() const { return int(_nodes.size()); }
+
+private:
+	std::vector<struct ga_job_graph_node_t*> _nodes;
+
+	/* Nodes without predecessors, kept together so they start in one run call. */
+	std::vector<ga_job_decl_t> _root_decls;
+};
@@ -0,0 +1,202 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_profiler.h"
+
+#include "framework/ga_compiler_defines.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct ga_profile_event_t
+{
+	const char* _name;
+	uint64_t _time;
+	uint64_t _arg;
+	ga_profile_event_type_t _type;
+};
+
+/*
+** A single thread's events.
+** _head only ever increases; the event for index i lives at i & mask.
+*/
+struct ga_profile_thread_t
+{
+	static const uint32_t k_capacity = 64 * 1024;
+
+	ga_profile_event_t _events[k_capacity];
+	std::atomic<uint64_t> _head;
+
+	char _name[32];
+};
+
+static const int k_ga_profiler_max_threads = 128;
+
+static std::atomic<ga_profile_thread_t*> _ga_profiler_threads[k_ga_profiler_max_threads];
+static std::atomic_int _ga_profiler_thread_count(0);
+
+static thread_local ga_profile_thread_t* _ga_profiler_thread = 0;
+
+static const std::chrono::steady_clock::time_point _ga_profiler_epoch = std::chrono::steady_clock::now();
+
+/*
+** Not inlined: fibers migrate between threads, so the thread-local has to be
+** looked up again on every event.
+*/
+static GA_NOINLINE ga_profile_thread_t* _ga_profiler_get_thread()
+{
+	ga_profile_thread_t* thread = _ga_profiler_thread;
+	if (!thread)
+	{
+		int index = _ga_profiler_thread_count.fetch_add(1);
+		if (index >= k_ga_profiler_max_threads)
+		{
+			_ga_profiler_thread_count--;
+			return 0;
+		}
+
+		thread = new ga_profile_thread_t;
+		thread->_head = 0;
+		snprintf(thread->_name, sizeof(thread->_name), "thread %d", index);
+
+		_ga_profiler_threads[index].store(thread, std::memory_order_release);
+		_ga_profiler_thread = thread;
+	}
+	return thread;
+}
+
+static void _ga_profiler_write(ga_profile_event_type_t type, const char* name, uint64_t time, uint64_t arg)
+{
+	ga_profile_thread_t* thread = _ga_profiler_get_thread();
+	if (!thread)
+	{
+		return;
+	}
+
+	uint64_t head = thread->_head.load(std::memory_order_relaxed);
+	ga_profile_event_t& e = thread->_events[head & (ga_profile_thread_t::k_capacity - 1)];
+	e._name = name;
+	e._time = time;
+	e._arg = arg;
+	e._type = type;
+	thread->_head.store(head + 1, std::memory_order_release);
+}
+
+void ga_profiler::record(ga_profile_event_type_t type, const char* name, uint64_t arg)
+{
+	_ga_profiler_write(type, name, get_time_ns(), arg);
+}
+
+void ga_profiler::record_scope(const char* name, uint64_t begin_ns)
+{
+	uint64_t end_ns = get_time_ns();
+	_ga_profiler_write(k_profile_scope, name, begin_ns, end_ns - begin_ns);
+}
+
+void ga_profiler::set_thread_name(const char* name)
+{
+	ga_profile_thread_t* thread = _ga_profiler_get_thread();
+	if (thread)
+	{
+		snprintf(thread->_name, sizeof(thread->_name), "%s", name);
+	}
+}
+
+uint64_t ga_profiler::get_time_ns()
+{
+	auto elapsed = std::chrono::steady_clock::now() - _ga_profiler_epoch;
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+bool ga_profiler::dump(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+
+	int thread_count = _ga_profiler_thread_count.load();
+	if (thread_count > k_ga_profiler_max_threads)
+	{
+		thread_count = k_ga_profiler_max_threads;
+	}
+
+	std::vector<ga_profile_event_t> events;
+	for (int tid = 0; tid < thread_count; ++tid)
+	{
+		ga_profile_thread_t* thread = _ga_profiler_threads[tid].load(std::memory_order_acquire);
+		if (!thread)
+		{
+			continue;
+		}
+
+		/*
+		** Copy the most recent events out, then throw away any the owning
+		** thread may have overwritten while we were copying.
+		*/
+		const uint64_t k_capacity = ga_profile_thread_t::k_capacity;
+		uint64_t head = thread->_head.load(std::memory_order_acquire);
+		uint64_t tail = head > k_capacity ? head - k_capacity : 0;
+
+		events.clear();
+		for (uint64_t i = tail; i < head; ++i)
+		{
+			events.push_back(thread->_events[i & (k_capacity - 1)]);
+		}
+
+		uint64_t new_head = thread->_head.load(std::memory_order_acquire);
+		uint64_t overwritten = new_head > head ? new_head - head : 0;
+		size_t skip = overwritten < events.size() ? size_t(overwritten) : events.size();
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", tid, thread->_name);
+		first = false;
+
+		for (size_t i = skip; i < events.size(); ++i)
+		{
+			const ga_profile_event_t& e = events[i];
+			double ts = e._time / 1000.0;
+
+			switch (e._type)
+			{
+			case k_profile_job_start:
+			case k_profile_job_resume:
+				fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"job\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"entry\":\"0x%llx\",\"resumed\":%s}}",
+					e._name, ts, tid, (unsigned long long)e._arg, e._type == k_profile_job_resume ? "true" : "false");
+				break;
+			case k_profile_job_end:
+			case k_profile_job_suspend:
+				fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"suspended\":%s}}",
+					ts, tid, e._type == k_profile_job_suspend ? "true" : "false");
+				break;
+			case k_profile_idle_begin:
+				fprintf(file, ",\n{\"name\":\"idle\",\"cat\":\"idle\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, tid);
+				break;
+			case k_profile_idle_end:
+				fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, tid);
+				break;
+			case k_profile_scope:
+				fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"scope\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+					e._name, ts, e._arg / 1000.0, tid);
+				break;
+			}
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
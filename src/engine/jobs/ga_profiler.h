@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstdint>
+
+/*
+** Build with GA_PROFILER=1 to record job system and user scope events.
+** When it's 0, every GA_PROFILE_* macro compiles to nothing.
+*/
+#if !defined(GA_PROFILER)
+#define GA_PROFILER 0
+#endif
+
+/*
+** Types of recorded events.
+*/
+enum ga_profile_event_type_t
+{
+	k_profile_job_start,
+	k_profile_job_resume,
+	k_profile_job_end,
+	k_profile_job_suspend,
+	k_profile_idle_begin,
+	k_profile_idle_end,
+	k_profile_scope,
+};
+
+/*
+** Records events into a lock-free ring buffer per thread, and dumps them as
+** Chrome trace_event JSON (load in chrome://tracing or ui.perfetto.dev).
+** Only the owning thread writes its buffer; when it wraps, the oldest events
+** are overwritten.
+*/
+class ga_profiler
+{
+public:
+	static void record(ga_profile_event_type_t type, const char* name, uint64_t arg);
+	static void record_scope(const char* name, uint64_t begin_ns);
+
+	static void set_thread_name(const char* name);
+
+	static uint64_t get_time_ns();
+
+	static bool dump(const char* path);
+};
+
+/*
+** Records the lifetime of a C++ scope as a single complete event.
+** The event is written when the scope ends, so it stays well formed even if
+** a fiber is suspended inside it and resumed on another thread.
+*/
+class ga_profile_scope
+{
+public:
+	ga_profile_scope(const char* name) : _name(name), _begin(ga_profiler::get_time_ns()) {}
+	~ga_profile_scope() { ga_profiler::record_scope(_name, _begin); }
+
+private:
+	const char* _name;
+	uint64_t _begin;
+};
+
+#define GA_PROFILE_CONCAT_INNER(a, b) a##b
+#define GA_PROFILE_CONCAT(a, b) GA_PROFILE_CONCAT_INNER(a, b)
+
+#if GA_PROFILER
+#define GA_PROFILE_SCOPE(name) ga_profile_scope GA_PROFILE_CONCAT(_ga_profile_scope_, __LINE__)(name)
+#define GA_PROFILE_EVENT(type, name, arg) ga_profiler::record(type, name, arg)
+#define GA_PROFILE_THREAD_NAME(name) ga_profiler::set_thread_name(name)
+#define GA_PROFILE_DUMP(path) ga_profiler::dump(path)
+#else
+#define GA_PROFILE_SCOPE(name)
+#define GA_PROFILE_EVENT(type, name, arg)
+#define GA_PROFILE_THREAD_NAME(name)
+#define GA_PROFILE_DUMP(path)
+#endif
@@ -11,6 +11,9 @@
 
 #include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
 
 struct ga_queue_nodecount_t
 {
@@ -25,9 +28,13 @@ union ga_queue_pointer_t
 	uint64_t _entire;
 	ga_queue_nodecount_t _part;
 
+	/*
+	** Copies load atomically, so the compiler can't reuse an earlier read of
+	** a shared head, tail or link, or hoist one out of a retry loop.
+	*/
 	ga_queue_pointer_t() {}
-	ga_queue_pointer_t(const ga_queue_pointer_t& other) : _entire(other._entire) {}
-	ga_queue_pointer_t& operator=(const ga_queue_pointer_t& other) { _entire = other._entire; return *this; }
+	ga_queue_pointer_t(const ga_queue_pointer_t& other) : _entire(other._atomic.load()) {}
+	ga_queue_pointer_t& operator=(const ga_queue_pointer_t& other) { _entire = other._atomic.load(); return *this; }
 };
 
 struct ga_queue_node_t
@@ -36,6 +43,11 @@ struct ga_queue_node_t
 	ga_queue_pointer_t _next;
 };
 
+/*
+** Nodes live in equally sized, power of two segments. A segment is never
+** freed or moved once added, since other threads may still be reading
+** nodes in it through a stale head or tail.
+*/
 struct ga_queue_impl_t
 {
 	ga_queue_pointer_t _head;
@@ -43,8 +55,17 @@ struct ga_queue_impl_t
 	ga_queue_pointer_t _free_list;
 
 	std::atomic_int _count;
+	std::atomic_int _high_water;
+
+	uint32_t _segment_shift;
+	uint32_t _segment_mask;
+	int _max_segment_count;
 
-	ga_queue_node_t* _nodes;
+	std::atomic_int _segment_count;
+	ga_queue_node_t** _segments;
+	std::mutex _grow_mutex;
+
+	std::atomic_bool _reported_full;
 };
 
 static const uint32_t k_ga_queue_invalid_index = 0xffffffff;
@@ -52,23 +73,38 @@ static const uint32_t k_ga_queue_invalid_index = 0xffffffff;
 static uint32_t _alloc_node_index(ga_queue_impl_t* impl);
 static void _free_node_index(ga_queue_impl_t* impl, uint32_t index);
 static ga_queue_node_t* _init_node(ga_queue_impl_t* impl, uint32_t node_index);
+static bool _grow(ga_queue_impl_t* impl);
 
-ga_queue::ga_queue(int node_count)
+static ga_queue_node_t* _get_node(ga_queue_impl_t* impl, uint32_t index)
+{
+	return impl->_segments[index >> impl->_segment_shift] + (index & impl->_segment_mask);
+}
+
+ga_queue::ga_queue(int node_count, int max_node_count)
 {
 	auto impl = new ga_queue_impl_t;
 
-	impl->_count = 0;
-	impl->_free_list._entire = 0;
-	impl->_nodes = new ga_queue_node_t[node_count];
+	max_node_count = max_node_count > node_count ? max_node_count : node_count;
 
-	/* Link nodes together. */
-	for (int i = 0; i < node_count - 1; ++i)
+	uint32_t shift = 0;
+	while ((1u << shift) < uint32_t(node_count))
 	{
-		impl->_nodes[i]._next._part._index = i + 1;
-		impl->_nodes[i]._next._part._count = 0;
+		++shift;
 	}
-	impl->_nodes[node_count - 1]._next._part._index = k_ga_queue_invalid_index;
-	impl->_nodes[node_count - 1]._next._part._count = 0;
+	uint32_t segment_size = 1u << shift;
+
+	impl->_count = 0;
+	impl->_high_water = 0;
+	impl->_free_list._part._index = k_ga_queue_invalid_index;
+	impl->_free_list._part._count = 0;
+	impl->_segment_shift = shift;
+	impl->_segment_mask = segment_size - 1;
+	impl->_max_segment_count = int((uint32_t(max_node_count) + segment_size - 1) >> shift);
+	impl->_segment_count = 0;
+	impl->_segments = new ga_queue_node_t*[impl->_max_segment_count];
+	impl->_reported_full = false;
+
+	_grow(impl);
 
 	/* Populate the queue with a dummy node. */
 	uint32_t dummy_index = _alloc_node_index(impl);
@@ -85,16 +121,44 @@ ga_queue::ga_queue(int node_count)
 ga_queue::~ga_queue()
 {
 	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
-	delete[] impl->_nodes;
+	for (int i = 0; i < impl->_segment_count; ++i)
+	{
+		delete[] impl->_segments[i];
+	}
+	delete[] impl->_segments;
 	delete impl;
 }
 
 void ga_queue::push(void* data)
+{
+	if (try_push(data))
+	{
+		return;
+	}
+
+	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
+	if (!impl->_reported_full.exchange(true))
+	{
+		printf("ga_queue: full at %d entries; raise its limit.\n", get_max_node_count());
+	}
+
+	while (!try_push(data))
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool ga_queue::try_push(void* data)
 {
 	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
 
 	/* Allocate a new node for this data. */
 	uint32_t node_index = _alloc_node_index(impl);
+	if (node_index == k_ga_queue_invalid_index)
+	{
+		return false;
+	}
+
 	ga_queue_node_t* node = _init_node(impl, node_index);
 	node->_data = data;
 
@@ -104,10 +168,10 @@ void ga_queue::push(void* data)
 	for (;;)
 	{
 		tail = impl->_tail;
-		ga_queue_pointer_t next = impl->_nodes[tail._part._index]._next;
+		ga_queue_pointer_t next = _get_node(impl, tail._part._index)->_next;
 
 		/* Is our view of the queue still consistent? If not, try again. */
-		if (tail._entire == impl->_tail._entire)
+		if (tail._entire == impl->_tail._atomic.load())
 		{
 			/* Is tail pointing to last node? */
 			if (next._part._index == k_ga_queue_invalid_index)
@@ -116,7 +180,7 @@ void ga_queue::push(void* data)
 				ga_queue_pointer_t link;
 				link._part._index = node_index;
 				link._part._count = next._part._count + 1;
-				if (impl->_nodes[tail._part._index]._next._atomic.compare_exchange_strong(next._entire, link._entire))
+				if (_get_node(impl, tail._part._index)->_next._atomic.compare_exchange_strong(next._entire, link._entire))
 				{
 					break;
 				}
@@ -139,8 +203,13 @@ void ga_queue::push(void* data)
 		link._part._index = node_index;
 		link._part._count = tail._part._count + 1;
 		impl->_tail._atomic.compare_exchange_strong(tail._entire, link._entire);
-		impl->_count++;
 	}
+
+	int count = ++impl->_count;
+	int high_water = impl->_high_water.load(std::memory_order_relaxed);
+	while (count > high_water && !impl->_high_water.compare_exchange_weak(high_water, count)) {}
+
+	return true;
 }
 
 bool ga_queue::pop(void** data)
@@ -152,10 +221,10 @@ bool ga_queue::pop(void** data)
 	{
 		head = impl->_head;
 		ga_queue_pointer_t tail = impl->_tail;
-		ga_queue_pointer_t next = impl->_nodes[head._part._index]._next;
+		ga_queue_pointer_t next = _get_node(impl, head._part._index)->_next;
 
 		/* Is our view of the queue still consistent? If not, try again. */
-		if (head._entire == impl->_head._entire)
+		if (head._entire == impl->_head._atomic.load())
 		{
 			if (head._part._index == tail._part._index)
 			{
@@ -174,7 +243,7 @@ bool ga_queue::pop(void** data)
 			else
 			{
 				/* Grab the data. */
-				*data = impl->_nodes[next._part._index]._data;
+				*data = _get_node(impl, next._part._index)->_data;
 
 				/* Attempt to pop the node. Leave the loop on success. */
 				ga_queue_pointer_t link;
@@ -199,6 +268,24 @@ int ga_queue::get_count() const
 	return impl->_count;
 }
 
+int ga_queue::get_node_count() const
+{
+	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
+	return impl->_segment_count << impl->_segment_shift;
+}
+
+int ga_queue::get_max_node_count() const
+{
+	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
+	return impl->_max_segment_count << impl->_segment_shift;
+}
+
+int ga_queue::get_high_water() const
+{
+	ga_queue_impl_t* impl = static_cast<ga_queue_impl_t*>(_impl);
+	return impl->_high_water;
+}
+
 static uint32_t _alloc_node_index(ga_queue_impl_t* impl)
 {
 	uint32_t index;
@@ -210,7 +297,7 @@ static uint32_t _alloc_node_index(ga_queue_impl_t* impl)
 		if (free_list._part._index != k_ga_queue_invalid_index)
 		{
 			index = free_list._part._index;
-			ga_queue_pointer_t next = impl->_nodes[index]._next;
+			ga_queue_pointer_t next = _get_node(impl, index)->_next;
 
 			ga_queue_pointer_t link;
 			link._part._index = next._part._index;
@@ -220,6 +307,10 @@ static uint32_t _alloc_node_index(ga_queue_impl_t* impl)
 				break;
 			}
 		}
+		else if (!_grow(impl))
+		{
+			return k_ga_queue_invalid_index;
+		}
 	}
 
 	return index;
@@ -227,7 +318,7 @@ static uint32_t _alloc_node_index(ga_queue_impl_t* impl)
 
 static void _free_node_index(ga_queue_impl_t* impl, uint32_t index)
 {
-	ga_queue_node_t* node = impl->_nodes + index;
+	ga_queue_node_t* node = _get_node(impl, index);
 	for (;;)
 	{
 		ga_queue_pointer_t free_list = impl->_free_list;
@@ -245,7 +336,7 @@ static void _free_node_index(ga_queue_impl_t* impl, uint32_t index)
 
 static ga_queue_node_t* _init_node(ga_queue_impl_t* impl, uint32_t node_index)
 {
-	ga_queue_node_t* node = impl->_nodes + node_index;
+	ga_queue_node_t* node = _get_node(impl, node_index);
 	node->_data = 0;
 	node->_next._part._index = k_ga_queue_invalid_index;
 	node->_next._part._count = 0;
@@ -254,3 +345,55 @@ static ga_queue_node_t* _init_node(ga_queue_impl_t* impl, uint32_t node_index)
 
 	return node;
 }
+
+/*
+** Adds a segment and pushes all of its nodes onto the free list at once.
+** Returns true if the free list may have nodes to hand out again.
+*/
+static bool _grow(ga_queue_impl_t* impl)
+{
+	std::lock_guard<std::mutex> lock(impl->_grow_mutex);
+
+	/* Someone else grew the queue, or nodes were freed, while we waited. */
+	ga_queue_pointer_t free_list = impl->_free_list;
+	if (free_list._part._index != k_ga_queue_invalid_index)
+	{
+		return true;
+	}
+
+	int segment_index = impl->_segment_count;
+	if (segment_index >= impl->_max_segment_count)
+	{
+		return false;
+	}
+
+	uint32_t segment_size = impl->_segment_mask + 1;
+	uint32_t first = uint32_t(segment_index) << impl->_segment_shift;
+
+	ga_queue_node_t* segment = new ga_queue_node_t[segment_size];
+	for (uint32_t i = 0; i < segment_size - 1; ++i)
+	{
+		segment[i]._next._part._index = first + i + 1;
+		segment[i]._next._part._count = 0;
+	}
+	impl->_segments[segment_index] = segment;
+	impl->_segment_count = segment_index + 1;
+
+	ga_queue_node_t* tail = segment + (segment_size - 1);
+	for (;;)
+	{
+		free_list = impl->_free_list;
+		tail->_next._part._index = free_list._part._index;
+		tail->_next._part._count = 0;
+
+		ga_queue_pointer_t link;
+		link._part._index = first;
+		link._part._count = free_list._part._count + 1;
+		if (impl->_free_list._atomic.compare_exchange_strong(free_list._entire, link._entire))
+		{
+			break;
+		}
+	}
+
+	return true;
+}
@@ -11,19 +11,30 @@
 
 /*
 ** Thread-safe, lock-free queue.
+** Starts with node_count nodes and grows a segment at a time, up to
+** max_node_count, when it runs out. Zero means it never grows.
 ** https://www.research.ibm.com/people/m/michael/podc-1996.pdf
 */
 class ga_queue
 {
 public:
-	ga_queue(int node_count);
+	ga_queue(int node_count, int max_node_count = 0);
 	~ga_queue();
 
+	/* push waits for a pop once the queue is at its limit; try_push fails instead. */
 	void push(void* data);
+	bool try_push(void* data);
 	bool pop(void** data);
 
 	int get_count() const;
 
+	/* Nodes allocated now, and the most the queue will ever allocate. */
+	int get_node_count() const;
+	int get_max_node_count() const;
+
+	/* Most entries ever queued at once. */
+	int get_high_water() const;
+
 private:
 	void* _impl;
 };
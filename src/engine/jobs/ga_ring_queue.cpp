@@ -0,0 +1,190 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_ring_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+static const int k_ga_ring_queue_cache_line = 64;
+
+struct ga_ring_queue_cell_t
+{
+	std::atomic<uint64_t> _sequence;
+	void* _data;
+};
+
+struct ga_ring_queue_impl_t
+{
+	char _pad0[k_ga_ring_queue_cache_line];
+
+	std::atomic<uint64_t> _enqueue_pos;
+	char _pad1[k_ga_ring_queue_cache_line - sizeof(std::atomic<uint64_t>)];
+
+	std::atomic<uint64_t> _dequeue_pos;
+	char _pad2[k_ga_ring_queue_cache_line - sizeof(std::atomic<uint64_t>)];
+
+	ga_ring_queue_cell_t* _cells;
+	uint64_t _mask;
+
+	std::atomic_int _high_water;
+};
+
+ga_ring_queue::ga_ring_queue(int node_count, int max_node_count)
+{
+	auto impl = new ga_ring_queue_impl_t;
+
+	node_count = max_node_count > node_count ? max_node_count : node_count;
+
+	/* Round up to a power of two so positions can be masked into the ring. */
+	uint64_t size = 2;
+	while (size < uint64_t(node_count))
+	{
+		size <<= 1;
+	}
+
+	impl->_cells = new ga_ring_queue_cell_t[size];
+	impl->_mask = size - 1;
+	for (uint64_t i = 0; i < size; ++i)
+	{
+		impl->_cells[i]._sequence.store(i, std::memory_order_relaxed);
+		impl->_cells[i]._data = 0;
+	}
+
+	impl->_enqueue_pos.store(0, std::memory_order_relaxed);
+	impl->_dequeue_pos.store(0, std::memory_order_relaxed);
+	impl->_high_water.store(0, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_release);
+
+	_impl = impl;
+}
+
+ga_ring_queue::~ga_ring_queue()
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+	delete[] impl->_cells;
+	delete impl;
+}
+
+void ga_ring_queue::push(void* data)
+{
+	while (!try_push(data))
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool ga_ring_queue::try_push(void* data)
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+
+	ga_ring_queue_cell_t* cell;
+	uint64_t pos = impl->_enqueue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell = &impl->_cells[pos & impl->_mask];
+		uint64_t sequence = cell->_sequence.load(std::memory_order_acquire);
+		int64_t diff = int64_t(sequence) - int64_t(pos);
+
+		/* The cell is free for this lap: claim it. */
+		if (diff == 0)
+		{
+			if (impl->_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		/* The cell still holds last lap's data: full. */
+		else if (diff < 0)
+		{
+			return false;
+		}
+		/* Another producer got here first. */
+		else
+		{
+			pos = impl->_enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->_data = data;
+	cell->_sequence.store(pos + 1, std::memory_order_release);
+
+	if ((pos & 63) == 0)
+	{
+		uint64_t dequeue_pos = impl->_dequeue_pos.load(std::memory_order_relaxed);
+		int count = pos + 1 > dequeue_pos ? int(pos + 1 - dequeue_pos) : 0;
+		int high_water = impl->_high_water.load(std::memory_order_relaxed);
+		while (count > high_water && !impl->_high_water.compare_exchange_weak(high_water, count)) {}
+	}
+	return true;
+}
+
+bool ga_ring_queue::pop(void** data)
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+
+	ga_ring_queue_cell_t* cell;
+	uint64_t pos = impl->_dequeue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell = &impl->_cells[pos & impl->_mask];
+		uint64_t sequence = cell->_sequence.load(std::memory_order_acquire);
+		int64_t diff = int64_t(sequence) - int64_t(pos + 1);
+
+		/* The cell has been filled for this lap: claim it. */
+		if (diff == 0)
+		{
+			if (impl->_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		/* Nothing written here yet: empty. */
+		else if (diff < 0)
+		{
+			return false;
+		}
+		/* Another consumer got here first. */
+		else
+		{
+			pos = impl->_dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	*data = cell->_data;
+	cell->_sequence.store(pos + impl->_mask + 1, std::memory_order_release);
+	return true;
+}
+
+int ga_ring_queue::get_count() const
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+	uint64_t enqueue_pos = impl->_enqueue_pos.load(std::memory_order_relaxed);
+	uint64_t dequeue_pos = impl->_dequeue_pos.load(std::memory_order_relaxed);
+	return enqueue_pos > dequeue_pos ? int(enqueue_pos - dequeue_pos) : 0;
+}
+
+int ga_ring_queue::get_node_count() const
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+	return int(impl->_mask + 1);
+}
+
+int ga_ring_queue::get_max_node_count() const
+{
+	return get_node_count();
+}
+
+int ga_ring_queue::get_high_water() const
+{
+	ga_ring_queue_impl_t* impl = static_cast<ga_ring_queue_impl_t*>(_impl);
+	return impl->_high_water.load(std::memory_order_relaxed);
+}
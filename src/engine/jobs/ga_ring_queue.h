@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+/*
+** Thread-safe, lock-free, bounded queue.
+** A ring of cells, each with a sequence number that tells producers and
+** consumers whether it's theirs to fill or empty. Unlike ga_queue there is
+** no node free list, and the two ends live on separate cache lines.
+** Drop-in for ga_queue: push spins while the ring is full. The ring can't
+** grow, so given a max_node_count it is sized to that up front.
+** http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+*/
+class ga_ring_queue
+{
+public:
+	ga_ring_queue(int node_count, int max_node_count = 0);
+	~ga_ring_queue();
+
+	void push(void* data);
+	bool try_push(void* data);
+	bool pop(void** data);
+
+	int get_count() const;
+
+	int get_node_count() const;
+	int get_max_node_count() const;
+
+	/* Sampled every 64 pushes, to keep producers off the consumers' cache line. */
+	int get_high_water() const;
+
+private:
+	void* _impl;
+};
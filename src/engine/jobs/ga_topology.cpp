@@ -0,0 +1,248 @@
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include "ga_topology.h"
+
+#include "framework/ga_compiler_defines.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#if defined(GA_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(GA_MSVC) || defined(GA_MINGW)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#undef WIN32_LEAN_AND_MEAN
+#endif
+
+ga_cpu_set ga_cpu_set::from_mask(uint64_t mask)
+{
+	ga_cpu_set set;
+	set._words.push_back(mask);
+	return set;
+}
+
+void ga_cpu_set::set(int cpu)
+{
+	size_t word = size_t(cpu) / 64;
+	if (word >= _words.size())
+	{
+		_words.resize(word + 1, 0);
+	}
+	_words[word] |= uint64_t(1) << (cpu % 64);
+}
+
+void ga_cpu_set::clear(int cpu)
+{
+	size_t word = size_t(cpu) / 64;
+	if (word < _words.size())
+	{
+		_words[word] &= ~(uint64_t(1) << (cpu % 64));
+	}
+}
+
+bool ga_cpu_set::test(int cpu) const
+{
+	size_t word = size_t(cpu) / 64;
+	return word < _words.size() && (_words[word] & (uint64_t(1) << (cpu % 64))) != 0;
+}
+
+bool ga_cpu_set::empty() const
+{
+	return count() == 0;
+}
+
+int ga_cpu_set::count() const
+{
+	int result = 0;
+	for (uint64_t w : _words)
+	{
+		for (; w; w &= w - 1)
+		{
+			++result;
+		}
+	}
+	return result;
+}
+
+#if defined(GA_LINUX)
+static bool _ga_read_int(const char* path, int* value)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		return false;
+	}
+	bool result = fscanf(file, "%d", value) == 1;
+	fclose(file);
+	return result;
+}
+
+/* Parses a sysfs CPU list such as "0-3,8-11". */
+static bool _ga_read_cpu_list(const char* path, std::vector<int>* cpus)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		return false;
+	}
+
+	int first, last;
+	char separator;
+	while (fscanf(file, "%d", &first) == 1)
+	{
+		last = first;
+		if (fscanf(file, "%c", &separator) == 1 && separator == '-')
+		{
+			if (fscanf(file, "%d", &last) != 1)
+			{
+				break;
+			}
+			fscanf(file, "%c", &separator);
+		}
+		for (int cpu = first; cpu <= last; ++cpu)
+		{
+			cpus->push_back(cpu);
+		}
+	}
+
+	fclose(file);
+	return !cpus->empty();
+}
+#endif
+
+ga_cpu_topology::ga_cpu_topology() : _core_count(0), _package_count(0)
+{
+#if defined(GA_LINUX)
+	std::vector<int> online;
+	if (_ga_read_cpu_list("/sys/devices/system/cpu/online", &online))
+	{
+		for (int cpu : online)
+		{
+			char path[128];
+			ga_cpu_t info;
+			info._cpu = cpu;
+			info._smt_index = 0;
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+			if (!_ga_read_int(path, &info._core))
+			{
+				info._core = cpu;
+			}
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+			if (!_ga_read_int(path, &info._package))
+			{
+				info._package = 0;
+			}
+			_cpus.push_back(info);
+		}
+	}
+#endif
+
+	if (_cpus.empty())
+	{
+		int count = std::max(1, int(std::thread::hardware_concurrency()));
+		for (int cpu = 0; cpu < count; ++cpu)
+		{
+			ga_cpu_t info;
+			info._cpu = cpu;
+			info._core = cpu;
+			info._package = 0;
+			info._smt_index = 0;
+			_cpus.push_back(info);
+		}
+	}
+
+	/*
+	** Core ids are only unique within a package. Renumber cores densely across
+	** the machine, and number each core's hardware threads.
+	*/
+	std::vector<std::pair<int, int>> cores;
+	std::vector<int> packages;
+	for (auto& info : _cpus)
+	{
+		auto key = std::make_pair(info._package, info._core);
+		auto it = std::find(cores.begin(), cores.end(), key);
+		int core = int(it - cores.begin());
+		if (it == cores.end())
+		{
+			cores.push_back(key);
+		}
+
+		info._smt_index = 0;
+		for (auto& other : _cpus)
+		{
+			if (&other == &info)
+			{
+				break;
+			}
+			if (other._package == info._package && other._core == core)
+			{
+				++info._smt_index;
+			}
+		}
+		info._core = core;
+
+		if (std::find(packages.begin(), packages.end(), info._package) == packages.end())
+		{
+			packages.push_back(info._package);
+		}
+	}
+
+	_core_count = int(cores.size());
+	_package_count = int(packages.size());
+}
+
+std::vector<ga_cpu_t> ga_cpu_topology::select(const ga_cpu_set& cpus, bool use_smt_siblings) const
+{
+	std::vector<ga_cpu_t> result;
+	std::vector<int> used_cores;
+	for (auto& info : _cpus)
+	{
+		if (!cpus.empty() && !cpus.test(info._cpu))
+		{
+			continue;
+		}
+		if (!use_smt_siblings)
+		{
+			if (std::find(used_cores.begin(), used_cores.end(), info._core) != used_cores.end())
+			{
+				continue;
+			}
+			used_cores.push_back(info._core);
+		}
+		result.push_back(info);
+	}
+	return result;
+}
+
+bool ga_cpu_topology::pin_current_thread(int cpu)
+{
+#if defined(GA_LINUX)
+	cpu_set_t* set = CPU_ALLOC(cpu + 1);
+	size_t size = CPU_ALLOC_SIZE(cpu + 1);
+	CPU_ZERO_S(size, set);
+	CPU_SET_S(cpu, size, set);
+	bool result = pthread_setaffinity_np(pthread_self(), size, set) == 0;
+	CPU_FREE(set);
+	return result;
+#elif defined(GA_MSVC) || defined(GA_MINGW)
+	/* Processor groups aren't handled; only the first 64 CPUs can be pinned. */
+	if (cpu >= 64)
+	{
+		return false;
+	}
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+** RPI Game Architecture Engine
+**
+** Portions adapted from:
+** Viper Engine - Copyright (C) 2016 Velan Studios - All Rights Reserved
+**
+** This file is distributed under the MIT License. See LICENSE.txt.
+*/
+
+#include <cstdint>
+#include <vector>
+
+/*
+** A set of logical CPUs, of any width.
+*/
+class ga_cpu_set
+{
+public:
+	static ga_cpu_set from_mask(uint64_t mask);
+
+	void set(int cpu);
+	void clear(int cpu);
+	bool test(int cpu) const;
+
+	bool empty() const;
+	int count() const;
+
+private:
+	std::vector<uint64_t> _words;
+};
+
+/*
+** One logical CPU and where it sits in the machine.
+*/
+struct ga_cpu_t
+{
+	int _cpu;
+	int _core;
+	int _package;
+
+	/* 0 for the first hardware thread of a core, 1 for its SMT sibling, etc. */
+	int _smt_index;
+};
+
+/*
+** Layout of the online CPUs.
+** On Linux this is read from sysfs; elsewhere every logical CPU is assumed
+** to be its own core.
+*/
+class ga_cpu_topology
+{
+public:
+	ga_cpu_topology();
+
+	const std::vector<ga_cpu_t>& get_cpus() const { return _cpus; }
+	int get_core_count() const { return _core_count; }
+	int get_package_count() const { return _package_count; }
+
+	/*
+	** Pick CPUs to run workers on from those in the set (or all, if the set
+	** is empty): one per physical core, or every SMT sibling if requested.
+	*/
+	std::vector<ga_cpu_t> select(const ga_cpu_set& cpus, bool use_smt_siblings) const;
+
+	static bool pin_current_thread(int cpu);
+
+private:
+	std::vector<ga_cpu_t> _cpus;
+	int _core_count;
+	int _package_count;
+};
@@ -9,10 +9,14 @@
 
 #include "framework/ga_camera.h"
 #include "framework/ga_compiler_defines.h"
+#include "framework/ga_heap_counter.h"
 #include "framework/ga_input.h"
 #include "framework/ga_sim.h"
 #include "framework/ga_output.h"
+#include "jobs/ga_fiber_mutex.h"
 #include "jobs/ga_job.h"
+#include "jobs/ga_job_graph.h"
+#include "jobs/ga_profiler.h"
 
 #include "entity/ga_entity.h"
 #include "graphics/ga_animation.h"
@@ -29,17 +33,61 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb_truetype.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 #if defined(GA_MINGW)
 #include <unistd.h>
 #endif
 
 static void set_root_path(const char* exepath);
 
+// Most frames the sim may run ahead of the one being drawn, plus one.
+static const int k_max_frames_in_flight = 3;
+
+// Frames that may allocate while lists and arenas grow to their working size.
+static const uint64_t k_heap_warmup_frames = 10;
+
+// Everything the frame stages need, handed to each stage's job. There is one
+// per frame in flight.
+struct frame_stages_t
+{
+	ga_camera* _camera;
+	ga_sim* _sim;
+	ga_output* _output;
+	ga_frame_params* _params;
+
+	// The sim of the frame before this one, which this frame's sim follows.
+	ga_job_counter_t* _previous_sim;
+};
+
+static void wait_previous_sim(void* data);
+static void update_camera(void* data);
+static void update_sim(void* data);
+static void late_update_sim(void* data);
+static void update_output(void* data);
+
 int main(int argc, const char** argv)
 {
 	set_root_path(argv[0]);
 
-	ga_job::startup(0xffff, 256, 256);
+	// With one frame in flight, each frame's sim and output run back to back.
+	// With more, the sim fills the next frame while output draws this one.
+	int frames_in_flight = 2;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], "--frames-in-flight") == 0)
+		{
+			frames_in_flight = atoi(argv[i + 1]);
+		}
+	}
+	frames_in_flight = std::min(std::max(frames_in_flight, 1), k_max_frames_in_flight);
+
+	// Start the job system with one pinned worker per physical core.
+	ga_job_config_t job_config;
+	ga_job::startup(job_config);
 
 	// Create objects for three phases of the frame: input, sim and output.
 	ga_input* input = new ga_input();
@@ -61,37 +109,134 @@ int main(int argc, const char** argv)
 	ga_animation animation;
 	egg_to_animation("data/animations/bar_bend.egg", &animation, &animated_model);
 
-	ga_entity animated_entity;
+	ga_entity_handle animated_entity = sim->create_entity();
 	ga_animated_material* animated_material = new ga_animated_material(animated_model._skeleton);
-	ga_model_component model_component(&animated_entity, &animated_model, animated_material);
-	ga_animation_component animation_component(&animated_entity, &animated_model);
-	sim->add_entity(&animated_entity);
+	new ga_model_component(sim->get_entity(animated_entity), &animated_model, animated_material);
+	ga_animation_component* animation_component = new ga_animation_component(sim->get_entity(animated_entity), &animated_model);
+
+	animation_component->play(&animation);
 
-	animation_component.play(&animation);
+	// We pass frame state from input through sim to output using a params
+	// object. Each frame in flight has its own, reused once that frame is drawn.
+	ga_frame_params* frame_params = new ga_frame_params[frames_in_flight];
+
+	// A frame's sim counter is waited on by the next frame's sim, which only
+	// finishes before the frame after that is drawn. One counter more than
+	// frames in flight keeps each from being reused until then.
+	int sim_counter_count = frames_in_flight + 1;
+	ga_job_counter_t sim_counters[k_max_frames_in_flight + 1];
+
+	// Build each frame's sim stages once. The camera doesn't depend on the
+	// sim, so the two overlap; both follow the previous frame's sim, since
+	// they update state that carries over between frames. The late update
+	// emits drawcalls, whose sort keys need the camera's view.
+	frame_stages_t stages[k_max_frames_in_flight];
+	ga_job_graph sim_graphs[k_max_frames_in_flight];
+	ga_job_decl_t output_decls[k_max_frames_in_flight];
+	for (int i = 0; i < frames_in_flight; ++i)
+	{
+		stages[i] = { camera, sim, output, &frame_params[i], 0 };
+
+		ga_job_decl_t wait_decl;
+		wait_decl._entry = wait_previous_sim;
+		wait_decl._data = &stages[i];
+		wait_decl._priority = k_job_priority_critical;
+		wait_decl._stack = k_job_stack_small;
+
+		ga_job_decl_t camera_decl;
+		camera_decl._entry = update_camera;
+		camera_decl._data = &stages[i];
+		camera_decl._priority = k_job_priority_critical;
+
+		ga_job_decl_t sim_decl;
+		sim_decl._entry = update_sim;
+		sim_decl._data = &stages[i];
+		sim_decl._priority = k_job_priority_critical;
+
+		ga_job_decl_t late_sim_decl;
+		late_sim_decl._entry = late_update_sim;
+		late_sim_decl._data = &stages[i];
+		late_sim_decl._priority = k_job_priority_critical;
+
+		int wait_node = sim_graphs[i].add_node(wait_decl);
+		int camera_node = sim_graphs[i].add_node(camera_decl, { wait_node });
+		int sim_node = sim_graphs[i].add_node(sim_decl, { wait_node });
+		sim_graphs[i].add_node(late_sim_decl, { camera_node, sim_node });
+
+		// Output draws on the main thread, since it owns the GL context.
+		output_decls[i]._entry = update_output;
+		output_decls[i]._data = &stages[i];
+		output_decls[i]._priority = k_job_priority_critical;
+		output_decls[i]._main_thread_only = true;
+		output_decls[i]._stack = k_job_stack_large; // GL drivers can use a lot of stack.
+	}
+
+	// Heap allocations made by each pass of the main loop. Once warmed up,
+	// frames should make none.
+	uint64_t frame_allocations = 0;
+	uint64_t max_steady_allocations = 0;
+	uint64_t steady_allocations = 0;
+	uint64_t frame_count = 0;
 
 	// Main loop:
-	while (true)
+	for (uint64_t frame = 0; ; ++frame)
 	{
-		// We pass frame state through the 3 phases using a params object.
-		ga_frame_params params;
+		uint64_t allocations_begin = ga_heap_counter::get_allocation_count();
+
+		// This frame's params were last used frames_in_flight frames ago, and
+		// that frame has been drawn by now.
+		int slot = int(frame % frames_in_flight);
+		frame_params[slot].reset();
 
 		// Gather user input and current time.
-		if (!input->update(&params))
+		if (!input->update(&frame_params[slot]))
 		{
 			break;
 		}
 
-		// Update the camera.
-		camera->update(&params);
+		// Update the camera, run gameplay and the late update, once the
+		// previous frame's sim is done.
+		stages[slot]._previous_sim = &sim_counters[(frame + sim_counter_count - 1) % sim_counter_count];
+		sim_graphs[slot].run(&sim_counters[frame % sim_counter_count]);
 
-		// Run gameplay.
-		sim->update(&params);
+		// Draw the oldest frame in flight once its sim is done. Meanwhile the
+		// sims of the frames after it run on the workers.
+		if (frame + 1 >= uint64_t(frames_in_flight))
+		{
+			uint64_t draw_frame = frame + 1 - frames_in_flight;
+			ga_job::wait(&sim_counters[draw_frame % sim_counter_count]);
 
-		// Perform the late update.
-		sim->late_update(&params);
+			ga_job_counter_t output_counter;
+			ga_job::run(&output_decls[draw_frame % frames_in_flight], 1, &output_counter);
+			ga_job::wait(&output_counter);
+		}
 
-		// Draw to screen.
-		output->update(&params);
+		frame_allocations = ga_heap_counter::get_allocation_count() - allocations_begin;
+		if (frame >= k_heap_warmup_frames)
+		{
+			max_steady_allocations = std::max(max_steady_allocations, frame_allocations);
+			steady_allocations += frame_allocations;
+		}
+		frame_count = frame + 1;
+	}
+
+	// Let the sims still in flight finish; their frames are never drawn.
+	for (int i = 0; i < sim_counter_count; ++i)
+	{
+		ga_job::wait(&sim_counters[i]);
+	}
+	delete[] frame_params;
+
+	GA_PROFILE_DUMP("ga_trace.json");
+	ga_fiber_mutex::report_contention();
+
+	if (frame_count > k_heap_warmup_frames)
+	{
+		printf("Heap allocations per frame after %llu warmup frames: average %.2f, max %llu, last %llu\n",
+			(unsigned long long)k_heap_warmup_frames,
+			double(steady_allocations) / double(frame_count - k_heap_warmup_frames),
+			(unsigned long long)max_steady_allocations,
+			(unsigned long long)frame_allocations);
 	}
 
 	delete output;
@@ -104,6 +249,36 @@ int main(int argc, const char** argv)
 	return 0;
 }
 
+static void wait_previous_sim(void* data)
+{
+	frame_stages_t* stages = static_cast<frame_stages_t*>(data);
+	ga_job::wait(stages->_previous_sim);
+}
+
+static void update_camera(void* data)
+{
+	frame_stages_t* stages = static_cast<frame_stages_t*>(data);
+	stages->_camera->update(stages->_params);
+}
+
+static void update_sim(void* data)
+{
+	frame_stages_t* stages = static_cast<frame_stages_t*>(data);
+	stages->_sim->update(stages->_params);
+}
+
+static void late_update_sim(void* data)
+{
+	frame_stages_t* stages = static_cast<frame_stages_t*>(data);
+	stages->_sim->late_update(stages->_params);
+}
+
+static void update_output(void* data)
+{
+	frame_stages_t* stages = static_cast<frame_stages_t*>(data);
+	stages->_output->update(stages->_params);
+}
+
 char g_root_path[256];
 static void set_root_path(const char* exepath)
 {